@@ -25,6 +25,37 @@
 //HDF5:
 #include "hdf5.h"
 //#pragma comment(lib, "hdf5.lib")
+//parallel HDF5: MPI-IO file access and collective reads and writes, see FAProps::mpio() and XProps::collective()
+//#define H5TL_PARALLEL
+#ifdef H5TL_PARALLEL
+#ifndef H5_HAVE_PARALLEL
+#error "H5TL_PARALLEL needs an HDF5 built with --enable-parallel"
+#endif
+#include "mpi.h"
+#endif
+//optional built-in compression filters, see H5TL::filters. Define these here, or configure CMake with -DH5TL_ZSTD=ON or -DH5TL_LZ4=ON
+//#define H5TL_ZSTD
+//#define H5TL_LZ4
+#ifdef H5TL_ZSTD
+#include "zstd.h"
+#endif
+#ifdef H5TL_LZ4
+#include "lz4.h"
+#endif
+//vectorized type conversions, registered with HDF5 when the first file is opened, see H5TL::convert
+//#define H5TL_FAST_CONVERT
+//optional timing of every HDF5 call, see H5TL::stats()
+//#define H5TL_PROFILE
+#ifdef H5TL_PROFILE
+#include <chrono>
+#include <string>
+#endif
+//optional adapters for third-party array types. Define these here, on the compiler command line,
+//or by linking the H5TL::blitz, H5TL::opencv, H5TL::qt or H5TL::eigen CMake targets
+//#define H5TL_BLITZ_ADAPT
+//#define H5TL_OCV_ADAPT
+//#define H5TL_QT_ADAPT
+//#define H5TL_EIGEN_ADAPT
 
 
 //STL:
@@ -38,8 +69,31 @@
 #include <stdexcept>
 #include <sstream>
 #include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <map>
+#include <cstdlib>
+#include <new>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
 
 namespace H5TL {
+#if defined(_MSC_VER)
+#define H5TL_NOINLINE __declspec(noinline)
+#define H5TL_RESTRICT __restrict
+#else
+#define H5TL_NOINLINE __attribute__((noinline))
+#define H5TL_RESTRICT __restrict__
+#endif
+
     namespace util {
         template<typename InputIt, typename T>
         T product(InputIt first, InputIt last, T init) {
@@ -95,8 +149,14 @@ namespace H5TL {
     class Props;
     template<typename XX> class LProps_;
     template<typename XX> class DProps_;
+    template<typename XX> class FAProps_;
+    template<typename XX> class XProps_;
+    template<typename XX> class DAProps_;
     typedef LProps_<void> LProps;
     typedef DProps_<void> DProps;
+    typedef FAProps_<void> FAProps;
+    typedef XProps_<void> XProps;
+    typedef DAProps_<void> DAProps;
 
     template<typename XX> class DSpace_;
     typedef DSpace_<void> DSpace;
@@ -111,12 +171,39 @@ namespace H5TL {
     class Dataset;
     class Group;
     class File;
+    class Pyramid;
+    class Table;
+    template<typename T> class TimeSeries;
 
-    ///exception class for all HDF5 errors.
+    /** \brief exception class for all HDF5 errors.
+    *
+    * Errors raised by HDF5 calls hold a copy of the calling thread's HDF5 error stack, taken with H5Eget_current_stack
+    * when the error is detected. The stack is only walked and formatted into a message if what() is called, so errors
+    * that are caught and handled never build a string.
+    */
     class h5tl_error : public std::runtime_error {
+    protected:
+        //a copied error stack, shared by copies of the exception, and its message once formatted
+        struct stack_copy {
+            hid_t es;
+            std::string message;
+            std::once_flag formatted;
+            explicit stack_copy(hid_t es) : es(es) {}
+            ~stack_copy() {
+                if (es >= 0) H5Eclose_stack(es);
+            }
+        };
+        std::shared_ptr<stack_copy> stack_;
     public:
         explicit h5tl_error(const std::string& what_arg) : std::runtime_error(what_arg) {}
         explicit h5tl_error(const char* what_arg) : std::runtime_error(what_arg) {}
+        ///takes ownership of the error stack es, as returned by H5Eget_current_stack
+        explicit h5tl_error(hid_t es) : std::runtime_error("HDF5 error"), stack_(std::make_shared<stack_copy>(es)) {}
+        ///the copied HDF5 error stack, or -1 if there is none
+        hid_t stack() const {
+            return stack_ ? stack_->es : -1;
+        }
+        const char* what() const noexcept override;
     };
 
     ///class for walking the HDF5 error stack.
@@ -125,8 +212,7 @@ namespace H5TL {
     protected:
         //use constructor of private static member to run this when the library loads:
         ErrorHandler_() {
-            //disable automatic error printing
-            H5Eset_auto(H5E_DEFAULT, nullptr, nullptr);
+            init_thread();
         }
         static std::string class_name(hid_t class_id) {
             ssize_t len = H5Eget_class_name(class_id, nullptr, 0);
@@ -139,9 +225,26 @@ namespace H5TL {
             os << "#" << n << ": " << err_desc->file_name << " line " << err_desc->line << ": " << err_desc->func_name << "(): " << std::endl;
             os << "    " << H5Eget_major(err_desc->maj_num) << ": " << H5Eget_minor(err_desc->min_num) << ": " << err_desc->desc << std::endl;
             //os << "class: " << _error_class_name(err_desc->cls_id) << std::endl;
-            return 1;
+            return 0; //keep walking -- a positive value would stop at the first entry
         }
     public:
+        /** \brief Disable automatic error printing for the calling thread.
+        *
+        * Threadsafe builds of HDF5 keep a separate error stack, and automatic printing setting, for each thread. This
+        * runs for the loading thread automatically; other threads that call HDF5 should call it once before doing so.
+        */
+        static void init_thread() {
+            H5Eset_auto(H5E_DEFAULT, nullptr, nullptr);
+        }
+        /** \brief Return a std::string describing an HDF5 error stack, without clearing it.
+        * \param[in] es The error stack to walk.
+        * \return A string representation of the error stack.
+        */
+        std::string describe(hid_t es) const {
+            std::ostringstream oss;
+            H5Ewalk2(es, H5E_WALK_DOWNWARD, append_error, &oss);
+            return oss.str();
+        }
         /** \brief Return a std::string for the HDF5 error stack.
 
         Walks and then clears the indicated HDF5 error stack, building a string description of the current error.
@@ -149,10 +252,16 @@ namespace H5TL {
         \return A string representation of the error stack.
         */
         std::string get_error(hid_t es = H5E_DEFAULT) const {
-            std::ostringstream oss;
-            H5Ewalk2(es, H5E_WALK_DOWNWARD, append_error, &oss);
+            std::string tmp = describe(es);
             H5Eclear2(es);
-            return oss.str();
+            return tmp;
+        }
+        /** \brief Return an exception holding the calling thread's current error stack.
+        *
+        * The current stack is moved into the exception, leaving it clear for the next call.
+        */
+        h5tl_error current_error() const {
+            return h5tl_error(H5Eget_current_stack());
         }
         static const ErrorHandler_<void> EH;
     };
@@ -160,55 +269,124 @@ namespace H5TL {
     template<typename XX>
     const ErrorHandler ErrorHandler_<XX>::EH;
 
+    inline const char* h5tl_error::what() const noexcept {
+        if (!stack_)
+            return std::runtime_error::what();
+        try {
+            std::call_once(stack_->formatted, [this]{ stack_->message = ErrorHandler::EH.describe(stack_->es); });
+        }
+        catch (...) {
+            return std::runtime_error::what();
+        }
+        //a failure that left nothing on the stack still has the generic message
+        return stack_->message.empty() ? std::runtime_error::what() : stack_->message.c_str();
+    }
+
+    namespace util {
+        //the throwing half of the check functions is kept out of line, so the inlined checks are just a compare
+        [[noreturn]] H5TL_NOINLINE inline void throw_error() {
+            throw ErrorHandler::EH.current_error();
+        }
+    }
+
     /** \brief Checks an HDF5 herr_t return code for errors.
     *
-    * Checks an HDF5 herr_t return code for errors. If there is an error, throws an H5TL::h5tl_error with the message given by ErrorHandler::get_error().
+    * Checks an HDF5 herr_t return code for errors. If there is an error, throws an H5TL::h5tl_error holding the current error stack.
     * \param[in] e Error code to check, throws an H5TL::h5tl_error if e < 0.
     */
     inline void check(herr_t e) {
-        if (e < 0) throw h5tl_error(ErrorHandler::EH.get_error());
+        if (e < 0) util::throw_error();
     }
 
     /** \brief Checks an HDF5 htri_t return code for errors and converts it to a bool.
     *
-    * Checks an HDF5 tri_t return code for errors and converts it to a bool. If there is an error, throws an H5TL::h5tl_error with the message given by ErrorHandler::get_error().
+    * Checks an HDF5 tri_t return code for errors and converts it to a bool. If there is an error, throws an H5TL::h5tl_error holding the current error stack.
     * \param t The htri_t return code to check
     * \returns true if t > 0
     */
     inline bool check_tri(htri_t t) {
-        if (t < 0) throw h5tl_error(ErrorHandler::EH.get_error());
-        else return t > 0;
+        if (t < 0) util::throw_error();
+        return t > 0;
     }
     /** \brief Checks an HDF5 hid_t return code for errors.
     *
-    * Checks an HDF5 hid_t return code for errors and returns it. If there is an error, throws an H5TL::h5tl_error with the message given by ErrorHandler::get_error().
+    * Checks an HDF5 hid_t return code for errors and returns it. If there is an error, throws an H5TL::h5tl_error holding the current error stack.
     * \param id The hid_t return code to check.
     * \returns id, unchanged.
     */
     inline hid_t check_id(hid_t id) {
-        if (id < 0) throw h5tl_error(ErrorHandler::EH.get_error());
-        else return id;
+        if (id < 0) util::throw_error();
+        return id;
     }
     /** \brief Checks an HDF5 ssize_t return code for errors.
     *
-    * Checks an HDF5 ssize_t return code for errors and returns it. If there is an error, throws an H5TL::h5tl_error with the message given by ErrorHandler::get_error().
+    * Checks an HDF5 ssize_t return code for errors and returns it. If there is an error, throws an H5TL::h5tl_error holding the current error stack.
     * \param sz The ssize_t return code to check.
     * \returns sz, unchanged.
     */
     inline ssize_t check_ssize(ssize_t sz) {
-        if (sz < 0) throw h5tl_error(ErrorHandler::EH.get_error());
-        else return sz;
+        if (sz < 0) util::throw_error();
+        return sz;
     }
     /** \brief Checks an HDF5 hssize_t return code for errors.
     *
-    * Checks an HDF5 hssize_t return code for errors and returns it. If there is an error, throws an H5TL::h5tl_error with the message given by ErrorHandler::get_error().
+    * Checks an HDF5 hssize_t return code for errors and returns it. If there is an error, throws an H5TL::h5tl_error holding the current error stack.
     * \param sz The hssize_t return code to check.
     * \returns sz, unchanged.
     */
     inline hssize_t check_hssize(hssize_t sz) {
-        if (sz < 0) throw h5tl_error(ErrorHandler::EH.get_error());
-        else return sz;
+        if (sz < 0) util::throw_error();
+        return sz;
     }
+
+    /** \brief The value of an H5TL call that reports failure instead of throwing.
+    *
+    * Returned by the noexcept try_ functions, for probing where failure is a normal outcome. A failed result holds the
+    * calling thread's error stack, which value() and error() turn into an h5tl_error.
+    */
+    template<typename T>
+    class result {
+        T val;
+        hid_t es;
+        result() noexcept : val(), es(-1) {}
+    public:
+        result(T&& v) noexcept : val(std::move(v)), es(-1) {}
+        ///a failed result, taking the calling thread's current error stack
+        static result failure() noexcept {
+            result r;
+            r.es = H5Eget_current_stack();
+            if (r.es < 0) r.es = 0; //still failed, just without a stack to describe it
+            return r;
+        }
+        result(const result&) = delete;
+        result& operator=(const result&) = delete;
+        result(result&& r) noexcept : val(std::move(r.val)), es(r.es) { r.es = -1; }
+        result& operator=(result&& r) noexcept {
+            std::swap(val, r.val);
+            std::swap(es, r.es);
+            return *this;
+        }
+        ~result() {
+            if (es > 0) H5Eclose_stack(es);
+        }
+        bool ok() const noexcept { return es < 0; }
+        explicit operator bool() const noexcept { return ok(); }
+        ///the value, or throws the error
+        T& value() {
+            if (!ok()) throw error();
+            return val;
+        }
+        ///the value, or alt on failure
+        T value_or(T alt) noexcept {
+            return ok() ? std::move(val) : std::move(alt);
+        }
+        ///the error as an exception, which takes over the error stack. Call only on failure.
+        h5tl_error error() {
+            hid_t tmp = es;
+            es = 0;
+            return tmp > 0 ? h5tl_error(tmp) : h5tl_error("HDF5 error");
+        }
+    };
     /**
     Initializes the HDF5 library.
     */
@@ -222,34 +400,290 @@ namespace H5TL {
         check(H5close());
     }
 
+#ifdef H5TL_PROFILE
+    /** \brief Timers and counters for the HDF5 calls H5TL makes, compiled in by defining H5TL_PROFILE.
+    *
+    * Every HDF5 call H5TL makes on a dataset, attribute, group or file, other than counting references to its id, is
+    * timed and counted, with the bytes it moves, in a table for the calling thread keyed by the object's path and the
+    * operation. Calls are counted by the object's id, and its path is only looked up when it is closed or the counters
+    * are read, so timing a call costs a clock read and a map update. Times are inclusive: H5TL's own
+    * operations, like "Dataset::append", include the HDF5 calls they make, so the difference is H5TL's overhead. Reads
+    * and writes that convert between types are counted apart from those that don't, eg. as "H5Dread (convert)".
+    * Without H5TL_PROFILE, H5TL_PROFILED(op, obj, nbytes, call) and H5TL_PROFILED_CLOSE(op, obj, call) are just the
+    * call, and H5TL_PROFILE_SCOPE is nothing.
+    */
+    namespace profile {
+        //the object's path, or "" if it has none or is closed
+        inline std::string path(hid_t obj) {
+            char name[256];
+            ssize_t n = obj > 0 ? H5Iget_name(obj, name, sizeof(name)) : -1;
+            if (n <= 0) return std::string();
+            return std::string(name, std::min(size_t(n), sizeof(name) - 1));
+        }
+        struct counters {
+            uint64_t calls, ns, bytes;
+        };
+        struct thread_table {
+            unsigned thread;
+            std::mutex mutex; //only contended while the stats are read or reset
+            std::map<std::pair<hid_t, const char*>, counters> by_id; //by (object, operation), until its path is known
+            std::map<std::pair<std::string, std::string>, counters> entries; //by (path, operation)
+            //move the counters of obj to its path
+            void name(hid_t obj, const std::string& obj_path) {
+                auto it = by_id.lower_bound(std::make_pair(obj, (const char*)nullptr));
+                while (it != by_id.end() && it->first.first == obj) {
+                    counters& c = entries[std::make_pair(obj_path, std::string(it->first.second))];
+                    c.calls += it->second.calls;
+                    c.ns += it->second.ns;
+                    c.bytes += it->second.bytes;
+                    it = by_id.erase(it);
+                }
+            }
+            //name every object still counted by id. Call with mutex held
+            void name_all() {
+                while (!by_id.empty()) {
+                    hid_t obj = by_id.begin()->first.first;
+                    name(obj, path(obj));
+                }
+            }
+        };
+        //every thread's table, kept after the thread exits
+        struct registry {
+            std::mutex mutex;
+            std::vector<std::shared_ptr<thread_table>> tables;
+        };
+        inline registry& tables() {
+            static registry r;
+            return r;
+        }
+        inline thread_table& this_thread() {
+            thread_local std::shared_ptr<thread_table> table = [] {
+                std::shared_ptr<thread_table> t = std::make_shared<thread_table>();
+                registry& r = tables();
+                std::lock_guard<std::mutex> guard(r.mutex);
+                t->thread = unsigned(r.tables.size());
+                r.tables.push_back(t);
+                return t;
+            }();
+            return *table;
+        }
+        //bytes in the selection of space, of items of type
+        inline uint64_t nbytes(hid_t space, hid_t type) {
+            hssize_t n = H5Sget_select_npoints(space);
+            return n > 0 ? uint64_t(n)*H5Tget_size(type) : 0;
+        }
+        //bytes of mem_type items in the whole of attribute attr
+        inline uint64_t attribute_nbytes(hid_t attr, hid_t mem_type) {
+            hid_t space = H5Aget_space(attr);
+            uint64_t n = nbytes(space, mem_type);
+            H5Sclose(space);
+            return n;
+        }
+        //whether moving mem_type items to or from file_type needs a conversion. Closes file_type.
+        inline bool converts(hid_t file_type, hid_t mem_type) {
+            bool c = H5Tequal(file_type, mem_type) <= 0;
+            H5Tclose(file_type);
+            return c;
+        }
+        ///Times its own lifetime, and adds it to the calling thread's table. Recording never throws: a count that can't be
+        ///stored, eg. for want of memory, is dropped, so profiled calls in noexcept code stay noexcept
+        class scope {
+            const char* op;
+            hid_t obj;
+            uint64_t bytes;
+            bool closes;
+            std::string obj_path; //for a call that closes obj, looked up first
+            std::chrono::steady_clock::time_point t0;
+        public:
+            scope(const char* op, hid_t obj, uint64_t bytes = 0, bool closes = false) noexcept
+                : op(op), obj(obj), bytes(bytes), closes(closes) {
+                if (closes) {
+                    try {
+                        obj_path = path(obj);
+                    }
+                    catch (...) {}
+                }
+                t0 = std::chrono::steady_clock::now();
+            }
+            ~scope() {
+                uint64_t ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count());
+                try {
+                    thread_table& t = this_thread();
+                    {
+                        std::lock_guard<std::mutex> guard(t.mutex);
+                        counters& c = t.by_id[std::make_pair(obj, op)];
+                        c.calls += 1;
+                        c.ns += ns;
+                        c.bytes += bytes;
+                    }
+                    if (closes) {
+                        //other threads may have used the object too, eg. a ReaderPool's workers
+                        registry& r = tables();
+                        std::lock_guard<std::mutex> guard(r.mutex);
+                        for (auto &other : r.tables) {
+                            std::lock_guard<std::mutex> table_guard(other->mutex);
+                            other->name(obj, obj_path);
+                        }
+                    }
+                }
+                catch (...) {}
+            }
+        };
+        template<typename F>
+        auto timed(const char* op, hid_t obj, uint64_t bytes, F f) -> decltype(f()) {
+            scope s(op, obj, bytes);
+            return f();
+        }
+        template<typename F>
+        auto timed_close(const char* op, hid_t obj, F f) -> decltype(f()) {
+            scope s(op, obj, 0, true);
+            return f();
+        }
+    }
+#define H5TL_PROFILED(op, obj, nbytes, ...) ::H5TL::profile::timed(op, obj, nbytes, [&]() { return __VA_ARGS__; })
+#define H5TL_PROFILED_CLOSE(op, obj, ...) ::H5TL::profile::timed_close(op, obj, [&]() { return __VA_ARGS__; })
+#define H5TL_PROFILE_CONCAT_(a, b) a##b
+#define H5TL_PROFILE_NAME_(line) H5TL_PROFILE_CONCAT_(h5tl_profile_scope_, line)
+#define H5TL_PROFILE_SCOPE(op, obj) ::H5TL::profile::scope H5TL_PROFILE_NAME_(__LINE__)(op, obj)
+
+    /** \brief The profiling tables of every thread, see H5TL::profile
+    */
+    class Stats {
+    public:
+        struct entry {
+            unsigned thread; ///< index of the thread, in the order threads first made a call; or -1 in totals()
+            std::string path, op;
+            uint64_t calls, ns, bytes;
+        };
+        ///Every thread's counters
+        std::vector<entry> entries() const {
+            std::vector<entry> all;
+            profile::registry& r = profile::tables();
+            std::lock_guard<std::mutex> guard(r.mutex);
+            for (auto &t : r.tables) {
+                std::lock_guard<std::mutex> table_guard(t->mutex);
+                t->name_all();
+                for (auto &e : t->entries) {
+                    entry x = { t->thread, e.first.first, e.first.second, e.second.calls, e.second.ns, e.second.bytes };
+                    all.push_back(std::move(x));
+                }
+            }
+            return all;
+        }
+        ///The counters summed over threads, by path and operation
+        std::vector<entry> totals() const {
+            std::map<std::pair<std::string, std::string>, profile::counters> sums;
+            for (auto &e : entries()) {
+                profile::counters& c = sums[std::make_pair(e.path, e.op)];
+                c.calls += e.calls;
+                c.ns += e.ns;
+                c.bytes += e.bytes;
+            }
+            std::vector<entry> all;
+            for (auto &s : sums) {
+                entry x = { unsigned(-1), s.first.first, s.first.second, s.second.calls, s.second.ns, s.second.bytes };
+                all.push_back(std::move(x));
+            }
+            return all;
+        }
+        ///Zero every thread's counters
+        void reset() {
+            profile::registry& r = profile::tables();
+            std::lock_guard<std::mutex> guard(r.mutex);
+            for (auto &t : r.tables) {
+                std::lock_guard<std::mutex> table_guard(t->mutex);
+                t->by_id.clear();
+                t->entries.clear();
+            }
+        }
+        ///CSV with a header line: thread,path,op,calls,ns,bytes. thread is blank in totals.
+        std::string csv(bool per_thread = true) const {
+            std::ostringstream os;
+            os << "thread,path,op,calls,ns,bytes\n";
+            for (auto &e : per_thread ? entries() : totals()) {
+                if (e.thread != unsigned(-1)) os << e.thread;
+                os << "," << csv_field(e.path) << "," << csv_field(e.op) << "," << e.calls << "," << e.ns << "," << e.bytes << "\n";
+            }
+            return os.str();
+        }
+        ///JSON: an array of objects with the same fields as csv()
+        std::string json(bool per_thread = true) const {
+            std::ostringstream os;
+            os << "[";
+            bool first = true;
+            for (auto &e : per_thread ? entries() : totals()) {
+                os << (first ? "\n" : ",\n") << "  {";
+                if (e.thread != unsigned(-1)) os << "\"thread\": " << e.thread << ", ";
+                os << "\"path\": " << json_string(e.path) << ", \"op\": " << json_string(e.op)
+                    << ", \"calls\": " << e.calls << ", \"ns\": " << e.ns << ", \"bytes\": " << e.bytes << "}";
+                first = false;
+            }
+            os << "\n]\n";
+            return os.str();
+        }
+    protected:
+        static std::string csv_field(const std::string& s) {
+            std::string out("\"");
+            for (char c : s) {
+                if (c == '"') out += '"';
+                out += c;
+            }
+            return out + '"';
+        }
+        static std::string json_string(const std::string& s) {
+            std::string out("\"");
+            for (char c : s) {
+                if (c == '"' || c == '\\') out += '\\';
+                out += c;
+            }
+            return out + '"';
+        }
+    };
+    ///The profiling counters, see H5TL::profile
+    inline Stats stats() {
+        return Stats();
+    }
+#else
+#define H5TL_PROFILED(op, obj, nbytes, ...) (__VA_ARGS__)
+#define H5TL_PROFILED_CLOSE(op, obj, ...) (__VA_ARGS__)
+#define H5TL_PROFILE_SCOPE(op, obj)
+#endif
+
     inline void swap(ID&, ID&);
 
-    /** \brief Virtual class encapsulating an hid_t. */
+    /** \brief Base class encapsulating an hid_t.
+    *
+    * ID is not polymorphic: the hid_t conversion, comparisons and validity checks are inline, so passing a handle to
+    * the HDF5 C API costs the same as passing the bare hid_t. Each sub-class provides its own close(), which steal()
+    * finds statically from the type of its argument. Handles must not be deleted through a pointer to a base class.
+    */
     class ID {
         friend void swap(ID&, ID&);
     protected:
         hid_t id;
-        ID() : id(0) {}
+        ID() noexcept : id(0) {}
         ID(hid_t _id) : id(check_id(_id)) {}
         //copy constructor is protected - can be made public as necessary by sub-classes
-        ID(const ID& i) : id(i.id) {}
-        //copy assign is protected - can be made public as necessary by sub-classes
-        ID& operator=(const ID& i) {
-            if (id) close();
-            id = i.id;
-            return *this;
-        }
-        void steal(ID& i) {
-            if (id) close();
+        ID(const ID& i) noexcept : id(i.id) {}
+        ~ID() {}
+        //close the id using the close() of the most-derived type known here, then take ownership of i's id
+        template<typename id_t>
+        void steal(id_t& i) {
+            if (id) static_cast<id_t*>(this)->close();
             id = i.id;
             i.id = 0;
         }
-        void swap(ID& i1) {
+        void swap(ID& i1) noexcept {
             std::swap(id, i1.id);
         }
+        //add a reference to the id and return it, for constructing another handle that shares it
+        hid_t ref() const {
+            if (id) check(H5Iinc_ref(id));
+            return id;
+        }
     public:
         //move constructor
-        ID(ID &&i) : id(i.id) { i.id = 0; }
+        ID(ID &&i) noexcept : id(i.id) { i.id = 0; }
 
         //move assignment
         ID& operator=(ID&& i)  {
@@ -257,20 +691,39 @@ namespace H5TL {
             return *this;
         }
 
-        virtual ~ID() {}
-        virtual void close() = 0;
-        virtual operator hid_t() const { return id; }
-        virtual bool operator==(const ID& other) const {
-            return this == &other || id == other.id;
+        /** \brief Release the id without knowing its type.
+        *
+        * Decrements the reference count of the id, which closes it when the count reaches 0. Sub-classes hide this
+        * with the type-specific close function.
+        */
+        void close() {
+            check(H5Idec_ref(id)); id = 0;
         }
-        virtual bool operator<(const ID& other) const {
+        operator hid_t() const { return id; }
+        bool operator==(const ID& other) const {
+            return id == other.id;
+        }
+        bool operator<(const ID& other) const {
             return id < other.id;
         }
         /** \brief Checks that this ID refers to a valid HDF5 object.
         * \returns true if this refers to a valid HDF5 object.
         */
-        virtual bool valid() const { return check_tri(H5Iis_valid(id)); }
-        virtual operator bool() const { return valid(); }
+        bool valid() const { return check_tri(H5Iis_valid(id)); }
+        /** \brief Returns the number of handles sharing this id.
+        * \returns The application reference count of the id. Ids owned by the library, such as predefined types and
+        * default property lists, have a count of 0 and cannot be shared.
+        */
+        int refcount() const {
+            if (!id) return 0;
+            int n = H5Iget_ref(id);
+            check(n);
+            return n;
+        }
+        /** \brief Checks that this ID holds an id, without asking the library.
+        * \returns true if an id is held. Use valid() to check that the id is still open.
+        */
+        operator bool() const { return id > 0; }
 
     };
     inline void swap(ID& i0, ID& i1) {
@@ -294,13 +747,14 @@ namespace H5TL {
         DType_() : ID() {}
         //copy
         DType_(const DType_ &dt) : ID(check_id(H5Tcopy(dt))) {}
-        DType_& operator=(DType_ dt) {
-            swap(dt);
+        DType_& operator=(const DType_& dt) {
+            DType_ tmp(dt);
+            swap(tmp);
             return *this;
         }
 
         //move
-        DType_(DType_ &&dt) : ID(std::move(dt)) {}
+        DType_(DType_ &&dt) noexcept : ID(std::move(dt)) {}
         DType_& operator=(DType_&& dt) {
             steal(dt);
             return *this;
@@ -308,7 +762,15 @@ namespace H5TL {
         DType_(const DType_ &dt, size_t sz) : ID(check_id(H5Tcopy(dt))) {
             size(sz);
         }
-        virtual ~DType_() {
+        /** \brief Return a handle sharing this datatype, rather than a copy of it.
+        *
+        * Both handles refer to the same HDF5 datatype, so changes made through one are seen by the other. Predefined
+        * types cannot be shared and are copied instead.
+        */
+        DType_ share() const {
+            return refcount() ? DType_(ref()) : DType_(*this);
+        }
+        ~DType_() {
             if (id) close();
         }
         void close() {
@@ -323,10 +785,38 @@ namespace H5TL {
             if (sz == 0) check(H5Tset_size(id, H5T_VARIABLE));
             else check(H5Tset_size(id, sz));
         }
-        virtual size_t size() const {
+        size_t size() const {
             return H5Tget_size(id);
         }
-        virtual bool operator==(const DType_& other) const {
+        /** \brief Set the number of significant bits of an integer or float type
+        *
+        * Bits outside the precision are padding, which the n-bit filter (DProps::nbit()) drops from storage.
+        */
+        void precision(size_t bits) {
+            check(H5Tset_precision(id, bits));
+        }
+        size_t precision() const {
+            return H5Tget_precision(id);
+        }
+        ///Set the bit offset of the significant bits of an integer or float type
+        void offset(size_t bits) {
+            check(H5Tset_offset(id, bits));
+        }
+        size_t offset() const {
+            return size_t(H5Tget_offset(id));
+        }
+        ///Set the byte order of an atomic type, eg. H5T_ORDER_BE to write big-endian data
+        void order(H5T_order_t ord) {
+            check(H5Tset_order(id, ord));
+        }
+        H5T_order_t order() const {
+            return H5Tget_order(id);
+        }
+        ///the native type closest to this one, eg. for reading a dataset of this type into memory
+        DType_ native() const {
+            return DType_(check_id(H5Tget_native_type(id, H5T_DIR_ASCEND)));
+        }
+        bool operator==(const DType_& other) const {
             return check_tri(H5Tequal(id, other));
         }
         static const PDType NONE; ///< Not a valid type
@@ -341,6 +831,7 @@ namespace H5TL {
         static const PDType HSIZE; ///< Native hsize_t
         static const PDType FLOAT; ///< Native float type
         static const PDType DOUBLE; ///< Native double-precision float type
+        static const PDType BITS8; ///< Native 8-bit bitfield type, for packed flags (see BitMask)
         static const PDType STRING; ///< Native string character type (copy and set size for multi-character strings)
         static const PDType REFERENCE; ///< HDF5 object reference type
     };
@@ -352,17 +843,18 @@ namespace H5TL {
     public:
         //copy
         PDType(const PDType& dt) : DType(dt.id) {}
-        PDType& operator=(PDType dt) {
-            swap(dt);
+        PDType& operator=(const PDType& dt) {
+            PDType tmp(dt);
+            swap(tmp);
             return *this;
         }
         //move
-        PDType(PDType &&dt) : DType(std::move(dt)) {}
+        PDType(PDType &&dt) noexcept : DType(std::move(dt)) {}
         PDType& operator=(PDType&& dt) {
             steal(dt);
             return *this;
         }
-        virtual ~PDType() { id = 0; } //doesn't need to close(), but set id=0 so other destructors don't try to close it!
+        ~PDType() { id = 0; } //doesn't need to close(), but set id=0 so other destructors don't try to close it!
         void close() { id = 0; }
     };
 
@@ -378,9 +870,306 @@ namespace H5TL {
     template<typename XX> const PDType DType_<XX>::HSIZE = PDType(H5T_NATIVE_HSIZE);
     template<typename XX> const PDType DType_<XX>::FLOAT = PDType(H5T_NATIVE_FLOAT);
     template<typename XX> const PDType DType_<XX>::DOUBLE = PDType(H5T_NATIVE_DOUBLE);
+    template<typename XX> const PDType DType_<XX>::BITS8 = PDType(H5T_NATIVE_B8);
     template<typename XX> const PDType DType_<XX>::STRING = PDType(H5T_C_S1);
     template<typename XX> const PDType DType_<XX>::REFERENCE = PDType(H5T_STD_REF_OBJ);
 
+    //memory for reads: aligned allocation, and the hook used by the pointer adapters' allocate()
+    ///the size of a transparent huge page on Linux, and the size at which aligned_allocator<T, A, true> asks for them
+    const size_t huge_page_nbytes = size_t(1) << 21;
+
+    /** \brief Allocate nbytes aligned to align bytes, a power of 2. Free with aligned_deallocate().
+    * \throws std::bad_alloc
+    */
+    inline void* aligned_allocate(size_t nbytes, size_t align) {
+        align = std::max(align, sizeof(void*));
+#if defined(_MSC_VER)
+        void* p = _aligned_malloc(nbytes ? nbytes : 1, align);
+        if (!p) throw std::bad_alloc();
+#else
+        void* p = nullptr;
+        if (posix_memalign(&p, align, nbytes ? nbytes : 1) != 0) throw std::bad_alloc();
+#endif
+        return p;
+    }
+    inline void aligned_deallocate(void* p) {
+#if defined(_MSC_VER)
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+    ///Ask for transparent huge pages to back an allocation, which saves TLB misses on large reads. Does nothing off Linux.
+    inline void advise_huge_pages(void* p, size_t nbytes) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        //only whole huge pages can be advised
+        uintptr_t begin = (uintptr_t(p) + huge_page_nbytes - 1) & ~uintptr_t(huge_page_nbytes - 1);
+        uintptr_t end = (uintptr_t(p) + nbytes) & ~uintptr_t(huge_page_nbytes - 1);
+        if (end > begin)
+            madvise((void*)begin, end - begin, MADV_HUGEPAGE); //advice only: ignore failure
+#else
+        (void)p; (void)nbytes;
+#endif
+    }
+
+    /** \brief A standard allocator whose memory is aligned to Align bytes, eg. 64 for AVX-512 or 4096 for whole pages.
+    *
+    * With HugePages, allocations of at least huge_page_nbytes are aligned to it and advised to use huge pages.
+    * Elements are default-initialized, so arithmetic types are left uninitialized rather than zeroed: a buffer made to
+    * read into isn't written twice. See aligned_vector.
+    */
+    template<typename T, size_t Align = 64, bool HugePages = false>
+    class aligned_allocator {
+        static_assert((Align & (Align - 1)) == 0, "Align must be a power of 2");
+    public:
+        typedef T value_type;
+        template<typename U> struct rebind { typedef aligned_allocator<U, Align, HugePages> other; };
+        aligned_allocator() noexcept {}
+        template<typename U> aligned_allocator(const aligned_allocator<U, Align, HugePages>&) noexcept {}
+        T* allocate(size_t n) {
+            size_t nbytes = n * sizeof(T);
+            if (HugePages && nbytes >= huge_page_nbytes) {
+                void* p = aligned_allocate(nbytes, std::max(Align, huge_page_nbytes));
+                advise_huge_pages(p, nbytes);
+                return static_cast<T*>(p);
+            }
+            return static_cast<T*>(aligned_allocate(nbytes, std::max(Align, alignof(T))));
+        }
+        void deallocate(T* p, size_t) noexcept {
+            aligned_deallocate(p);
+        }
+        template<typename U> void construct(U* p) {
+            ::new((void*)p) U;
+        }
+        template<typename U, typename... Args> void construct(U* p, Args&&... args) {
+            ::new((void*)p) U(std::forward<Args>(args)...);
+        }
+        template<typename U> bool operator==(const aligned_allocator<U, Align, HugePages>&) const noexcept { return true; }
+        template<typename U> bool operator!=(const aligned_allocator<U, Align, HugePages>&) const noexcept { return false; }
+    };
+    ///A std::vector aligned to Align bytes, eg. Dataset::read<aligned_vector<float>>() for SIMD kernels
+    template<typename T, size_t Align = 64>
+    using aligned_vector = std::vector<T, aligned_allocator<T, Align>>;
+    ///A std::vector aligned to pages, and backed by huge pages once it is large enough
+    template<typename T>
+    using huge_page_vector = std::vector<T, aligned_allocator<T, 4096, true>>;
+
+    /** \brief A replacement for how allocate<T*>(), allocate<T[N]>() and allocate<void*>() get memory, eg. for
+    * Dataset::read<float*>().
+    *
+    * None is set by default, and the buffers come from new[] as always: free a T* with delete[], and a void* with
+    * ::operator delete[]. Once set_allocation() sets one, buffers of trivial types come from it instead, and must be
+    * freed with H5TL::deallocate(), which frees the default buffers too. It is global, and deallocate() frees with the one
+    * set when it is called, so set it once, before any buffers are allocated and while no other thread is using H5TL.
+    */
+    struct allocation {
+        void* (*allocate)(size_t nbytes);
+        void (*deallocate)(void* p);
+    };
+    namespace detail {
+        inline allocation& current_allocation() {
+            static allocation a = { nullptr, nullptr };
+            return a;
+        }
+        //n items from the allocation, if one is set and can hold data_t, or new[]
+        template<typename data_t>
+        typename std::enable_if<std::is_trivial<data_t>::value, data_t*>::type allocate_array(size_t n) {
+            const allocation& a = current_allocation();
+            return a.allocate ? static_cast<data_t*>(a.allocate(n * sizeof(data_t))) : new data_t[n];
+        }
+        template<typename data_t>
+        typename std::enable_if<!std::is_trivial<data_t>::value, data_t*>::type allocate_array(size_t n) {
+            return new data_t[n];
+        }
+        template<typename data_t>
+        typename std::enable_if<std::is_trivial<data_t>::value>::type deallocate_array(data_t* p) {
+            const allocation& a = current_allocation();
+            if (a.deallocate) a.deallocate((void*)p);
+            else delete[] p;
+        }
+        template<typename data_t>
+        typename std::enable_if<!std::is_trivial<data_t>::value>::type deallocate_array(data_t* p) {
+            delete[] p;
+        }
+    }
+    ///set the allocation for every later allocate() and deallocate(), or allocation() for new[]. Not synchronized, see H5TL::allocation
+    inline void set_allocation(const allocation& a) {
+        detail::current_allocation() = a;
+    }
+    ///eg. set_allocation(aligned_allocation<64>()) to align the buffers for AVX-512
+    template<size_t Align>
+    allocation aligned_allocation() {
+        struct aligned {
+            static void* allocate(size_t nbytes) { return aligned_allocate(nbytes, Align); }
+        };
+        allocation a = { &aligned::allocate, &aligned_deallocate };
+        return a;
+    }
+    ///free a buffer from allocate<T*>() or allocate<T[N]>(), with the allocation set, or delete[] if there is none
+    template<typename T>
+    void deallocate(T* p) {
+        detail::deallocate_array(p);
+    }
+    ///free a buffer from allocate<void*>(), with the allocation set, or ::operator delete[] if there is none
+    inline void deallocate(void* p) {
+        const allocation& a = detail::current_allocation();
+        if (a.deallocate) a.deallocate(p);
+        else ::operator delete[](p);
+    }
+
+    /** \brief Flags packed 8 to a byte, the first in the most significant bit.
+    *
+    * Group::write() stores a BitMask as a dataset of bytes, with an H5TL_bits attribute for the number of flags, and
+    * Dataset::read<BitMask>() reads it back; std::vector<bool> is written and read the same way. Flags are packed and
+    * unpacked 8 at a time, with one multiply each. The unused bits of the last byte are always 0.
+    */
+    class BitMask {
+    protected:
+        aligned_vector<uint8_t> bytes;
+        size_t nbits;
+
+        static bool little_endian() {
+            const uint16_t one = 1;
+            uint8_t first;
+            std::memcpy(&first, &one, 1);
+            return first == 1;
+        }
+        void clear_tail() {
+            if (nbits % 8) bytes.back() &= uint8_t(0xff << (8 - nbits % 8));
+        }
+    public:
+        BitMask() : nbits(0) {}
+        explicit BitMask(size_t n, bool value = false) : bytes((n + 7) / 8, value ? 0xff : 0), nbits(n) {
+            clear_tail();
+        }
+        BitMask(const bool* flags, size_t n) : bytes((n + 7) / 8), nbits(n) {
+            pack(flags, n, bytes.data());
+        }
+        template<typename A>
+        BitMask(const std::vector<bool, A>& flags) : bytes((flags.size() + 7) / 8), nbits(flags.size()) {
+            //vector<bool> has no array of bools to pack from, so go through one on the stack
+            bool tmp[4096];
+            for (size_t i = 0; i < nbits; i += sizeof(tmp)) {
+                size_t n = std::min(sizeof(tmp), nbits - i);
+                std::copy(flags.begin() + i, flags.begin() + i + n, tmp);
+                pack(tmp, n, bytes.data() + i / 8);
+            }
+        }
+        /** \brief Copy n flags out of packed bytes, starting from flag first.
+        */
+        static BitMask from_bytes(const uint8_t* packed, size_t first, size_t n) {
+            BitMask mask;
+            mask.nbits = n;
+            mask.bytes.resize((n + 7) / 8);
+            packed += first / 8;
+            unsigned shift = unsigned(first % 8);
+            if (shift == 0) {
+                std::copy(packed, packed + mask.bytes.size(), mask.bytes.begin());
+            }
+            else {
+                //the last byte may only need bits from packed[j]
+                size_t nsrc = (shift + n + 7) / 8;
+                for (size_t j = 0; j < mask.bytes.size(); ++j)
+                    mask.bytes[j] = uint8_t((packed[j] << shift) | (j + 1 < nsrc ? packed[j + 1] >> (8 - shift) : 0));
+            }
+            mask.clear_tail();
+            return mask;
+        }
+        ///number of flags
+        size_t size() const { return nbits; }
+        ///number of bytes holding the flags
+        size_t nbytes() const { return bytes.size(); }
+        uint8_t* data() { return bytes.data(); }
+        const uint8_t* data() const { return bytes.data(); }
+        bool operator[](size_t i) const {
+            return (bytes[i / 8] >> (7 - i % 8)) & 1;
+        }
+        void set(size_t i, bool value = true) {
+            uint8_t bit = uint8_t(0x80 >> (i % 8));
+            if (value) bytes[i / 8] |= bit;
+            else bytes[i / 8] &= uint8_t(~bit);
+        }
+        ///change the number of flags: new flags are false
+        void resize(size_t n) {
+            bytes.resize((n + 7) / 8, 0);
+            nbits = n;
+            clear_tail();
+        }
+        ///number of flags that are set
+        size_t count() const {
+            size_t c = 0, i = 0;
+            for (; i + 8 <= bytes.size(); i += 8) {
+                uint64_t w;
+                std::memcpy(&w, bytes.data() + i, 8);
+                //sum bits in pairs, nibbles and bytes, then add up the bytes
+                w = w - ((w >> 1) & 0x5555555555555555ull);
+                w = (w & 0x3333333333333333ull) + ((w >> 2) & 0x3333333333333333ull);
+                w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0full;
+                c += size_t((w * 0x0101010101010101ull) >> 56);
+            }
+            for (; i < bytes.size(); ++i)
+                for (uint8_t b = bytes[i]; b; b &= uint8_t(b - 1)) ++c;
+            return c;
+        }
+        void unpack(bool* flags) const {
+            unpack(bytes.data(), nbits, flags);
+        }
+        std::vector<bool> to_vector() const {
+            std::vector<bool> flags(nbits);
+            bool tmp[4096];
+            for (size_t i = 0; i < nbits; i += sizeof(tmp)) {
+                size_t n = std::min(sizeof(tmp), nbits - i);
+                unpack(bytes.data() + i / 8, n, tmp);
+                std::copy(tmp, tmp + n, flags.begin() + i);
+            }
+            return flags;
+        }
+        bool operator==(const BitMask& other) const {
+            return nbits == other.nbits && std::equal(bytes.begin(), bytes.end(), other.bytes.begin());
+        }
+        bool operator!=(const BitMask& other) const {
+            return !(*this == other);
+        }
+        /** \brief Pack n flags into (n + 7)/8 bytes.
+        *
+        * 8 flags are read as one word of 0 and 1 bytes; multiplying by 0x8040201008040201 moves the byte for flag k to
+        * bit 63 - k, so the top byte of the product is the packed flags.
+        */
+        static void pack(const bool* flags, size_t n, uint8_t* packed) {
+            size_t i = 0;
+            if (sizeof(bool) == 1 && little_endian()) {
+                for (; i + 8 <= n; i += 8) {
+                    uint64_t w;
+                    std::memcpy(&w, flags + i, 8);
+                    packed[i / 8] = uint8_t((w * 0x8040201008040201ull) >> 56);
+                }
+            }
+            for (; i < n; i += 8) {
+                uint8_t b = 0;
+                for (size_t k = 0; k < 8 && i + k < n; ++k)
+                    if (flags[i + k]) b |= uint8_t(0x80 >> k);
+                packed[i / 8] = b;
+            }
+        }
+        /** \brief Unpack n flags from (n + 7)/8 bytes.
+        *
+        * Each byte is copied to all 8 bytes of a word, and byte k masked to bit 7 - k; adding 0x7f to each byte carries
+        * into its top bit if it's not 0, which is shifted down to give the flag.
+        */
+        static void unpack(const uint8_t* packed, size_t n, bool* flags) {
+            size_t i = 0;
+            if (sizeof(bool) == 1 && little_endian()) {
+                for (; i + 8 <= n; i += 8) {
+                    uint64_t w = (uint64_t(packed[i / 8]) * 0x0101010101010101ull) & 0x0102040810204080ull;
+                    w = ((w + 0x7f7f7f7f7f7f7f7full) >> 7) & 0x0101010101010101ull;
+                    std::memcpy(flags + i, &w, 8);
+                }
+            }
+            for (; i < n; ++i)
+                flags[i] = ((packed[i / 8] >> (7 - i % 8)) & 1) != 0;
+        }
+    };
+
     //functions to return reference to predefined datatype using overload resolution
 	inline const DType& pdtype(int8_t) { return DType::INT8; }
 	inline const DType& pdtype(uint8_t) { return DType::UINT8; }
@@ -470,6 +1259,148 @@ namespace H5TL {
         allocate(const std::vector<hsize_t>& shape, const DType& dt = DType::NONE) {
             return adapt<data_t>::allocate(shape, dt);
     }
+
+    /** \brief Choose a chunk shape from the expected shape of a dataset and the way it will be read.
+    *
+    * Declare the accesses the dataset will see -- row scans, column scans, tiles at random positions -- then plan()
+    * tries every chunk shape with power-of-two (or full) sides that fits in the chunk cache, and returns the one with the
+    * lowest weighted cost per access. The cost counts a fixed overhead for each chunk touched, plus the bytes of those
+    * chunks, since HDF5 reads any chunk that fits in the cache whole. Scans keep reusing the chunks of one read until they
+    * step past them. Compressed chunks also have to be decompressed, so their bytes cost more, and they are kept large
+    * enough to compress well.
+    *
+    * eg. DProps().chunked(ChunkPlanner({ 100000, 512 }, 4).rows().tiles({ 256, 256 }, 0.5).compressed()).deflate(3);
+    */
+    class ChunkPlanner {
+    protected:
+        struct access {
+            std::vector<hsize_t> block; //shape of each read, 0 for a whole dimension
+            int scan_dim; //dimension that consecutive reads step along, or -1 for reads at random positions
+            double weight;
+        };
+        std::vector<hsize_t> final_shape;
+        size_t item_nbytes, cache_nbytes;
+        bool is_compressed;
+        std::vector<access> accesses;
+        //fixed cost of touching one more chunk (index lookup, I/O call, filter setup), as an equivalent number of bytes
+        static double chunk_overhead_nbytes() { return 65536.0; }
+        //smaller chunks bloat the chunk index (and compress poorly), unless the whole dataset is smaller
+        size_t min_chunk_nbytes() const { return is_compressed ? 65536 : 8192; }
+
+        double block_length(const access& a, size_t d) const {
+            return double(a.block[d] ? std::min(a.block[d], final_shape[d]) : final_shape[d]);
+        }
+        void search(std::vector<hsize_t>& chunk, size_t d, double chunk_nbytes, double min_nbytes,
+            std::vector<hsize_t>& best, double& best_cost, double& best_nbytes) const {
+            if (d == chunk.size()) {
+                if (chunk_nbytes < min_nbytes) return;
+                double c = cost(chunk);
+                //on a tie, fewer larger chunks keep the index smaller
+                if (best.empty() || c < best_cost || (c == best_cost && chunk_nbytes > best_nbytes)) {
+                    best = chunk; best_cost = c; best_nbytes = chunk_nbytes;
+                }
+                return;
+            }
+            for (hsize_t c = 1;; c = std::min(2 * c, final_shape[d])) {
+                //every later dimension is at least 1, so once a side overflows the cache, larger ones will too
+                if (chunk_nbytes*double(c) > double(cache_nbytes) && c > 1) break;
+                chunk[d] = c;
+                search(chunk, d + 1, chunk_nbytes*double(c), min_nbytes, best, best_cost, best_nbytes);
+                if (c == final_shape[d]) break;
+            }
+        }
+    public:
+        /** \brief Plan chunks for a dataset expected to grow to final_shape, with items of item_nbytes each.
+        *
+        * For unlimited dimensions, pass an estimate of their final length.
+        */
+        ChunkPlanner(const std::vector<hsize_t>& final_shape, size_t item_nbytes)
+            : final_shape(final_shape), item_nbytes(item_nbytes), cache_nbytes(size_t(1) << 20), is_compressed(false) {
+            for (auto &d : this->final_shape) if (d == 0) d = 1;
+        }
+        ///Reads of single rows (one index of the first dimension), one after another
+        ChunkPlanner& rows(double weight = 1) {
+            std::vector<hsize_t> block(final_shape.size(), 0);
+            if (!block.empty()) block.front() = 1;
+            return add(block, 0, weight);
+        }
+        ///Reads of single columns (one index of the last dimension), one after another
+        ChunkPlanner& columns(double weight = 1) {
+            std::vector<hsize_t> block(final_shape.size(), 0);
+            if (!block.empty()) block.back() = 1;
+            return add(block, int(block.size()) - 1, weight);
+        }
+        ///Reads of tile-shaped blocks at random positions, 0 for a whole dimension
+        ChunkPlanner& tiles(const std::vector<hsize_t>& tile, double weight = 1) {
+            return add(tile, -1, weight);
+        }
+        ///Reads of block-shaped blocks stepping along scan_dim, or at random positions if scan_dim < 0
+        ChunkPlanner& add(const std::vector<hsize_t>& block, int scan_dim, double weight = 1) {
+            if (block.size() != final_shape.size())
+                throw std::runtime_error("access block must have the same rank as the dataset.");
+            if (scan_dim >= int(block.size()))
+                throw std::runtime_error("scan dimension out of range.");
+            access a = { block, scan_dim, weight };
+            accesses.push_back(a);
+            return *this;
+        }
+        ///Size of the chunk cache the dataset will be read through (HDF5's default is 1 MB)
+        ChunkPlanner& cache(size_t nbytes) {
+            cache_nbytes = nbytes;
+            return *this;
+        }
+        ///Whether the dataset will be compressed, or have any other filters
+        ChunkPlanner& compressed(bool c = true) {
+            is_compressed = c;
+            return *this;
+        }
+        ///Expected cost of an access using the given chunk shape, in equivalent bytes read, averaged by weight
+        double cost(const std::vector<hsize_t>& chunk) const {
+            double chunk_nbytes = double(item_nbytes)*util::product(chunk.begin(), chunk.end(), 1.0);
+            double total = 0, weights = 0;
+            for (auto &a : accesses) {
+                double touched = 1, band = 1;
+                for (size_t d = 0; d < chunk.size(); ++d) {
+                    double b = block_length(a, d);
+                    if (b == double(final_shape[d])) {
+                        //the whole dimension: the chunks are aligned with it
+                        touched *= std::ceil(b / double(chunk[d]));
+                        band *= std::ceil(b / double(chunk[d]));
+                    }
+                    else {
+                        //a block of length b at a random offset overlaps (b - 1)/c + 1 chunks of length c, on average
+                        touched *= (b - 1) / double(chunk[d]) + 1;
+                        //and at most ceil((b - 1)/c) + 1 of them
+                        band *= std::ceil((b - 1) / double(chunk[d])) + 1;
+                    }
+                }
+                double c = touched*(chunk_overhead_nbytes() + (is_compressed ? 2 : 1)*chunk_nbytes);
+                //consecutive reads of a scan share chunks until they step past them -- if those chunks stay in the cache
+                if (a.scan_dim >= 0 && band*chunk_nbytes <= double(cache_nbytes))
+                    c /= std::max(1.0, double(chunk[a.scan_dim]) / block_length(a, a.scan_dim));
+                total += a.weight*c;
+                weights += a.weight;
+            }
+            return weights > 0 ? total / weights : 0;
+        }
+        ///Find the chunk shape with the lowest cost. If no accesses were declared, plans for row scans.
+        std::vector<hsize_t> plan() const {
+            if (accesses.empty()) {
+                ChunkPlanner p(*this);
+                return p.rows().plan();
+            }
+            std::vector<hsize_t> chunk(final_shape.size()), best;
+            double best_cost = 0, best_nbytes = 0;
+            double data_nbytes = double(item_nbytes)*util::product(final_shape.begin(), final_shape.end(), 1.0);
+            double min_nbytes = std::min(double(min_chunk_nbytes()), data_nbytes);
+            search(chunk, 0, double(item_nbytes), std::min(min_nbytes, double(cache_nbytes)), best, best_cost, best_nbytes);
+            //no shape between the minimum size and the cache size: take any that fits (one item per chunk always does)
+            if (best.empty())
+                search(chunk, 0, double(item_nbytes), 0, best, best_cost, best_nbytes);
+            return best;
+        }
+    };
+
     //property list
     class Props : public ID {
     protected:
@@ -478,20 +1409,28 @@ namespace H5TL {
     public:
         //copy
         Props(const Props &p) : ID(H5Pcopy(p)) {}
-        Props& operator=(Props p) {
-            swap(p);
+        Props& operator=(const Props& p) {
+            Props tmp(p);
+            swap(tmp);
             return *this;
         }
         //move
-        Props(Props &&p) : ID(std::move(p)) {}
+        Props(Props &&p) noexcept : ID(std::move(p)) {}
         Props& operator=(Props&& p) {
             steal(p);
             return *this;
         }
-        virtual ~Props() {
+        /** \brief Return a handle sharing this property list, rather than a copy of it.
+        *
+        * Default property lists cannot be shared and are copied instead.
+        */
+        Props share() const {
+            return refcount() ? Props(ref()) : Props(*this);
+        }
+        ~Props() {
             if (id) close();
         }
-        virtual void close() {
+        void close() {
             check(H5Pclose(id)); id = 0;
         }
     };
@@ -505,17 +1444,22 @@ namespace H5TL {
         LProps_() : Props(H5P_LINK_CREATE, 0) {}
         //copy
         LProps_(const LProps_ &lp) : Props(lp) {}
-        LProps_& operator=(LProps_ lp) {
-            swap(lp);
+        LProps_& operator=(const LProps_& lp) {
+            LProps_ tmp(lp);
+            swap(tmp);
             return *this;
         }
         //move
-        LProps_(LProps_ &&lp) : Props(std::move(lp)) {}
+        LProps_(LProps_ &&lp) noexcept : Props(std::move(lp)) {}
         LProps_& operator=(LProps_&& lp) {
             steal(lp);
             return *this;
         }
-        virtual ~LProps_() {}
+        ///Return a handle sharing this property list, see Props::share()
+        LProps_ share() const {
+            return refcount() ? LProps_(ref()) : LProps_(*this);
+        }
+        ~LProps_() {}
         LProps_& create_intermediate() {
             check(H5Pset_create_intermediate_group(id, 1));
             return *this;
@@ -524,34 +1468,373 @@ namespace H5TL {
 
     template<typename XX> const LProps LProps_<XX>::DEFAULT = LProps().create_intermediate();
 
-    //dataset creation properties
-    template<typename XX>
-    class DProps_ : public Props {
-        friend class Dataset;
-        DProps_(hid_t id) : Props(id) {}
-    public:
-        static const DProps_<void> DEFAULT;
-        DProps_() : Props(H5P_DATASET_CREATE, 0) {}
-        //copy
-        DProps_(const DProps_ &dp) : Props(dp) {}
-        DProps_& operator=(DProps_ dp) {
-            swap(dp);
-            return *this;
-        }
-        //move
-        DProps_(DProps_ &&dp) : Props(std::move(dp)) {}
-        DProps_& operator=(DProps_&& dp) {
-            steal(dp);
-            return *this;
-        }
-        virtual ~DProps_() {
-            if (id) close();
+    /** \brief Compression filters from the registered-filter list, with built-in implementations of some of them.
+    *
+    * Filters other than HDF5's own are normally loaded from plugins on HDF5_PLUGIN_PATH. Define H5TL_ZSTD (and link
+    * libzstd) or H5TL_LZ4 (and link liblz4) to have H5TL register its own implementation of those filters instead,
+    * writing the same format as the plugins. Blosc and bitshuffle still need their plugins.
+    */
+    namespace filters {
+        ///ids of the registered filters that DProps has setters for
+        enum : H5Z_filter_t {
+            BLOSC = 32001,
+            LZ4 = 32004,
+            BITSHUFFLE = 32008,
+            ZSTD = 32015
+        };
+
+        namespace detail {
+            //filter output buffers must come from the HDF5 library's allocator, as it frees them
+            inline void* allocate(size_t nbytes) {
+                return H5allocate_memory(nbytes, false);
+            }
+            inline size_t replace(void **buf, size_t *buf_size, void* out, size_t out_size, size_t out_nbytes) {
+                H5free_memory(*buf);
+                *buf = out;
+                *buf_size = out_size;
+                return out_nbytes;
+            }
+            inline void put_be(unsigned char* p, uint64_t x, int nbytes) {
+                for (int i = nbytes - 1; i >= 0; --i, x >>= 8)
+                    p[i] = (unsigned char)(x & 0xff);
+            }
+            inline uint64_t get_be(const unsigned char* p, int nbytes) {
+                uint64_t x = 0;
+                for (int i = 0; i < nbytes; ++i)
+                    x = (x << 8) | p[i];
+                return x;
+            }
         }
-        virtual void close() {
-            H5Pclose(id); id = 0;
+
+#ifdef H5TL_ZSTD
+        ///zstd filter: each chunk is one zstd frame. cd_values[0] is the compression level.
+        inline size_t zstd_filter(unsigned int flags, size_t cd_nelmts, const unsigned int cd_values[], size_t nbytes, size_t *buf_size, void **buf) {
+            if (flags & H5Z_FLAG_REVERSE) {
+                unsigned long long n = ZSTD_getFrameContentSize(*buf, nbytes);
+                if (n == ZSTD_CONTENTSIZE_ERROR || n == ZSTD_CONTENTSIZE_UNKNOWN) return 0;
+                void* out = detail::allocate(size_t(n));
+                if (!out && n) return 0;
+                size_t r = ZSTD_decompress(out, size_t(n), *buf, nbytes);
+                if (ZSTD_isError(r)) { H5free_memory(out); return 0; }
+                return detail::replace(buf, buf_size, out, size_t(n), r);
+            }
+            else {
+                int level = cd_nelmts > 0 ? int(cd_values[0]) : 0;
+                size_t bound = ZSTD_compressBound(nbytes);
+                void* out = detail::allocate(bound);
+                if (!out) return 0;
+                size_t r = ZSTD_compress(out, bound, *buf, nbytes, level);
+                if (ZSTD_isError(r)) { H5free_memory(out); return 0; }
+                return detail::replace(buf, buf_size, out, bound, r);
+            }
         }
-        //chainable property setters:
-        //eg. DProps().chunked().deflate(3).shuffle();
+#endif
+#ifdef H5TL_LZ4
+        /** \brief lz4 filter: cd_values[0] is the block size, 0 for the default of 1 GB.
+        *
+        * Each chunk is the big-endian 64-bit original size and 32-bit block size, then for each block its big-endian
+        * 32-bit compressed size and data. Blocks that don't compress are stored as they are, with their full size.
+        */
+        inline size_t lz4_filter(unsigned int flags, size_t cd_nelmts, const unsigned int cd_values[], size_t nbytes, size_t *buf_size, void **buf) {
+            const unsigned char* in = (const unsigned char*)*buf;
+            if (flags & H5Z_FLAG_REVERSE) {
+                if (nbytes < 12) return 0;
+                size_t orig_nbytes = size_t(detail::get_be(in, 8)), block_nbytes = size_t(detail::get_be(in + 8, 4));
+                if (block_nbytes == 0 && orig_nbytes > 0) return 0;
+                unsigned char* out = (unsigned char*)detail::allocate(orig_nbytes);
+                if (!out && orig_nbytes) return 0;
+                const unsigned char *src = in + 12, *end = in + nbytes;
+                for (size_t done = 0; done < orig_nbytes;) {
+                    size_t n = std::min(block_nbytes, orig_nbytes - done);
+                    if (end - src < 4) { H5free_memory(out); return 0; }
+                    size_t stored = size_t(detail::get_be(src, 4));
+                    src += 4;
+                    if (size_t(end - src) < stored) { H5free_memory(out); return 0; }
+                    if (stored == n)
+                        std::memcpy(out + done, src, n);
+                    else if (LZ4_decompress_safe((const char*)src, (char*)out + done, int(stored), int(n)) != int(n)) {
+                        H5free_memory(out);
+                        return 0;
+                    }
+                    src += stored;
+                    done += n;
+                }
+                return detail::replace(buf, buf_size, out, orig_nbytes, orig_nbytes);
+            }
+            else {
+                size_t block_nbytes = cd_nelmts > 0 && cd_values[0] ? cd_values[0] : size_t(1) << 30;
+                block_nbytes = std::max<size_t>(std::min(block_nbytes, nbytes), 1);
+                size_t nblocks = (nbytes + block_nbytes - 1) / block_nbytes;
+                size_t bound = 12 + nblocks*(4 + size_t(LZ4_compressBound(int(block_nbytes))));
+                unsigned char* out = (unsigned char*)detail::allocate(bound);
+                if (!out) return 0;
+                detail::put_be(out, nbytes, 8);
+                detail::put_be(out + 8, block_nbytes, 4);
+                unsigned char* dst = out + 12;
+                for (size_t done = 0; done < nbytes;) {
+                    size_t n = std::min(block_nbytes, nbytes - done);
+                    int c = LZ4_compress_default((const char*)in + done, (char*)dst + 4, int(n), int(bound - (dst + 4 - out)));
+                    if (c <= 0 || size_t(c) >= n) {
+                        //incompressible: store the block as it is
+                        std::memcpy(dst + 4, in + done, n);
+                        c = int(n);
+                    }
+                    detail::put_be(dst, uint64_t(c), 4);
+                    dst += 4 + c;
+                    done += n;
+                }
+                return detail::replace(buf, buf_size, out, bound, size_t(dst - out));
+            }
+        }
+#endif
+        /** \brief Register H5TL's built-in filter implementations with the library.
+        *
+        * Runs once, when the first file is opened or filter set. Does nothing unless H5TL_ZSTD or H5TL_LZ4 is defined.
+        */
+        inline void register_builtin() {
+            static const bool registered = [] {
+#ifdef H5TL_ZSTD
+                static const H5Z_class2_t zstd_class = {
+                    H5Z_CLASS_T_VERS, ZSTD, 1, 1, "Zstandard compression", nullptr, nullptr, zstd_filter
+                };
+                check(H5Zregister(&zstd_class));
+#endif
+#ifdef H5TL_LZ4
+                static const H5Z_class2_t lz4_class = {
+                    H5Z_CLASS_T_VERS, LZ4, 1, 1, "LZ4 compression", nullptr, nullptr, lz4_filter
+                };
+                check(H5Zregister(&lz4_class));
+#endif
+                return true;
+            }();
+            (void)registered;
+        }
+        ///whether the library can use filter id, loading its plugin if need be
+        inline bool available(H5Z_filter_t id) {
+            register_builtin();
+            return check_tri(H5Zfilter_avail(id));
+        }
+        /** \brief Throw an h5tl_error naming filter id if the library can't use it.
+        *
+        * \param name The filter's name, if known, eg. from a dataset's creation properties
+        */
+        inline void require(H5Z_filter_t id, const std::string& name = std::string()) {
+            if (available(id)) return;
+            std::ostringstream msg;
+            msg << "HDF5 filter " << id;
+            if (!name.empty()) msg << " (" << name << ")";
+            msg << " is not available: install its plugin on HDF5_PLUGIN_PATH";
+            if (id == ZSTD || id == LZ4) msg << ", or build with H5TL_" << (id == ZSTD ? "ZSTD" : "LZ4") << " defined";
+            throw h5tl_error(msg.str());
+        }
+    }
+
+    /** \brief Vectorized type conversions, registered with HDF5 in place of its own.
+    *
+    * HDF5 converts between types element by element, eg. reading int32 data into floats, or big-endian data on a
+    * little-endian machine. The kernels here convert the same pairs a block at a time, in loops the compiler
+    * vectorizes, and give the same values: integers are rounded to the nearest float, and doubles out of float's range
+    * become +-inf. They don't call the exception handler set by H5Pset_type_conv_cb.
+    *
+    * Registration changes conversions for the whole process and can't be undone, so it is not done unless asked for
+    * with register_fast(), or by defining H5TL_FAST_CONVERT.
+    */
+    namespace convert {
+        namespace detail {
+            //elements converted per block, through a buffer on the stack
+            const size_t block = 512;
+
+            template<typename S, typename D>
+            inline void convert_block(const S* H5TL_RESTRICT in, D* H5TL_RESTRICT out, size_t n) {
+                for (size_t i = 0; i < n; ++i)
+                    out[i] = static_cast<D>(in[i]);
+            }
+            inline uint16_t bswap(uint16_t x) { return uint16_t((x >> 8) | (x << 8)); }
+            inline uint32_t bswap(uint32_t x) {
+                return (x >> 24) | ((x >> 8) & 0x0000ff00u) | ((x << 8) & 0x00ff0000u) | (x << 24);
+            }
+            inline uint64_t bswap(uint64_t x) {
+                return (uint64_t(bswap(uint32_t(x))) << 32) | bswap(uint32_t(x >> 32));
+            }
+            //swapping doesn't change sizes, so each element is swapped where it is
+            template<typename U>
+            inline void swap_block(U* buf, size_t n) {
+                for (size_t i = 0; i < n; ++i)
+                    buf[i] = bswap(buf[i]);
+            }
+            //convert n packed elements of buf from S to D, in place.
+            //each block is copied out before it is overwritten: widening works back from the end, narrowing forward
+            template<typename S, typename D, void(*kernel)(const S*, D*, size_t)>
+            void in_place(void* buf, size_t n) {
+                S tmp[block];
+                char* b = (char*)buf;
+                if (sizeof(D) > sizeof(S)) {
+                    for (size_t end = n; end > 0;) {
+                        size_t k = std::min(block, end), i = end - k;
+                        std::memcpy(tmp, b + i*sizeof(S), k*sizeof(S));
+                        kernel(tmp, (D*)(b + i*sizeof(D)), k);
+                        end = i;
+                    }
+                }
+                else {
+                    for (size_t i = 0; i < n; i += block) {
+                        size_t k = std::min(block, n - i);
+                        std::memcpy(tmp, b + i*sizeof(S), k*sizeof(S));
+                        kernel(tmp, (D*)(b + i*sizeof(D)), k);
+                    }
+                }
+            }
+            //convert n elements spaced stride bytes apart: each has room for both types, so the order doesn't matter
+            template<typename S, typename D, void(*kernel)(const S*, D*, size_t)>
+            void strided(void* buf, size_t n, size_t stride) {
+                char* b = (char*)buf;
+                for (size_t i = 0; i < n; ++i, b += stride) {
+                    S s; D d;
+                    std::memcpy(&s, b, sizeof(S));
+                    kernel(&s, &d, 1);
+                    std::memcpy(b, &d, sizeof(D));
+                }
+            }
+            //an H5T_conv_t
+            template<typename S, typename D, void(*kernel)(const S*, D*, size_t)>
+            herr_t conversion(hid_t, hid_t, H5T_cdata_t* cdata, size_t nelmts, size_t buf_stride, size_t, void* buf, void*, hid_t) {
+                switch (cdata->command) {
+                case H5T_CONV_INIT:
+                    cdata->need_bkg = H5T_BKG_NO;
+                    return 0;
+                case H5T_CONV_FREE:
+                    return 0;
+                case H5T_CONV_CONV:
+                    if (buf_stride) strided<S, D, kernel>(buf, nelmts, buf_stride);
+                    else in_place<S, D, kernel>(buf, nelmts);
+                    return 0;
+                default:
+                    return -1;
+                }
+            }
+            template<typename U>
+            herr_t swapping(hid_t, hid_t, H5T_cdata_t* cdata, size_t nelmts, size_t buf_stride, size_t, void* buf, void*, hid_t) {
+                switch (cdata->command) {
+                case H5T_CONV_INIT:
+                    cdata->need_bkg = H5T_BKG_NO;
+                    return 0;
+                case H5T_CONV_FREE:
+                    return 0;
+                case H5T_CONV_CONV:
+                    if (buf_stride) {
+                        char* b = (char*)buf;
+                        for (size_t i = 0; i < nelmts; ++i, b += buf_stride) {
+                            U u;
+                            std::memcpy(&u, b, sizeof(U));
+                            u = bswap(u);
+                            std::memcpy(b, &u, sizeof(U));
+                        }
+                    }
+                    else swap_block((U*)buf, nelmts);
+                    return 0;
+                default:
+                    return -1;
+                }
+            }
+            template<typename S, typename D>
+            H5T_conv_t numeric() { return conversion<S, D, convert_block<S, D>>; }
+            template<typename U>
+            H5T_conv_t swap() { return swapping<U>; }
+
+            struct pair {
+                hid_t src, dst;
+                H5T_conv_t func;
+            };
+            //every conversion H5TL registers
+            inline std::vector<pair> pairs() {
+                std::vector<pair> p = {
+                    { H5T_NATIVE_INT8, H5T_NATIVE_FLOAT, numeric<int8_t, float>() },
+                    { H5T_NATIVE_UINT8, H5T_NATIVE_FLOAT, numeric<uint8_t, float>() },
+                    { H5T_NATIVE_INT16, H5T_NATIVE_FLOAT, numeric<int16_t, float>() },
+                    { H5T_NATIVE_UINT16, H5T_NATIVE_FLOAT, numeric<uint16_t, float>() },
+                    { H5T_NATIVE_INT32, H5T_NATIVE_FLOAT, numeric<int32_t, float>() },
+                    { H5T_NATIVE_UINT32, H5T_NATIVE_FLOAT, numeric<uint32_t, float>() },
+                    { H5T_NATIVE_INT64, H5T_NATIVE_FLOAT, numeric<int64_t, float>() },
+                    { H5T_NATIVE_UINT64, H5T_NATIVE_FLOAT, numeric<uint64_t, float>() },
+                    { H5T_NATIVE_INT8, H5T_NATIVE_DOUBLE, numeric<int8_t, double>() },
+                    { H5T_NATIVE_UINT8, H5T_NATIVE_DOUBLE, numeric<uint8_t, double>() },
+                    { H5T_NATIVE_INT16, H5T_NATIVE_DOUBLE, numeric<int16_t, double>() },
+                    { H5T_NATIVE_UINT16, H5T_NATIVE_DOUBLE, numeric<uint16_t, double>() },
+                    { H5T_NATIVE_INT32, H5T_NATIVE_DOUBLE, numeric<int32_t, double>() },
+                    { H5T_NATIVE_UINT32, H5T_NATIVE_DOUBLE, numeric<uint32_t, double>() },
+                    { H5T_NATIVE_INT64, H5T_NATIVE_DOUBLE, numeric<int64_t, double>() },
+                    { H5T_NATIVE_UINT64, H5T_NATIVE_DOUBLE, numeric<uint64_t, double>() },
+                    { H5T_NATIVE_FLOAT, H5T_NATIVE_DOUBLE, numeric<float, double>() },
+                    { H5T_NATIVE_DOUBLE, H5T_NATIVE_FLOAT, numeric<double, float>() },
+                };
+                //byte swapping, to and from the other byte order
+                bool little = H5Tget_order(H5T_NATIVE_INT32) == H5T_ORDER_LE;
+                std::array<pair, 8> swapped = {{
+                    { little ? H5T_STD_I16BE : H5T_STD_I16LE, H5T_NATIVE_INT16, swap<uint16_t>() },
+                    { little ? H5T_STD_U16BE : H5T_STD_U16LE, H5T_NATIVE_UINT16, swap<uint16_t>() },
+                    { little ? H5T_STD_I32BE : H5T_STD_I32LE, H5T_NATIVE_INT32, swap<uint32_t>() },
+                    { little ? H5T_STD_U32BE : H5T_STD_U32LE, H5T_NATIVE_UINT32, swap<uint32_t>() },
+                    { little ? H5T_STD_I64BE : H5T_STD_I64LE, H5T_NATIVE_INT64, swap<uint64_t>() },
+                    { little ? H5T_STD_U64BE : H5T_STD_U64LE, H5T_NATIVE_UINT64, swap<uint64_t>() },
+                    { little ? H5T_IEEE_F32BE : H5T_IEEE_F32LE, H5T_NATIVE_FLOAT, swap<uint32_t>() },
+                    { little ? H5T_IEEE_F64BE : H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE, swap<uint64_t>() },
+                }};
+                for (const pair& s : swapped) {
+                    p.push_back(s);
+                    p.push_back({ s.dst, s.src, s.func });
+                }
+                return p;
+            }
+            const char* const name = "H5TL vectorized";
+        }
+        /** \brief Register H5TL's conversions with HDF5, replacing its own for the same pairs of types.
+        *
+        * Covers 8- to 64-bit integers to float and double, float to double and back, and byte swapping of integers
+        * and floats. Runs once; HDF5 can't go back to its own hard conversions after they are replaced.
+        */
+        inline void register_fast() {
+            static const bool registered = [] {
+                for (const detail::pair& p : detail::pairs())
+                    check(H5Tregister(H5T_PERS_HARD, detail::name, p.src, p.dst, p.func));
+                return true;
+            }();
+            (void)registered;
+        }
+    }
+
+    //dataset creation properties
+    template<typename XX>
+    class DProps_ : public Props {
+        friend class Dataset;
+        DProps_(hid_t id) : Props(id) {}
+    public:
+        static const DProps_<void> DEFAULT;
+        DProps_() : Props(H5P_DATASET_CREATE, 0) {}
+        //copy
+        DProps_(const DProps_ &dp) : Props(dp) {}
+        DProps_& operator=(const DProps_& dp) {
+            DProps_ tmp(dp);
+            swap(tmp);
+            return *this;
+        }
+        //move
+        DProps_(DProps_ &&dp) noexcept : Props(std::move(dp)) {}
+        DProps_& operator=(DProps_&& dp) {
+            steal(dp);
+            return *this;
+        }
+        ///Return a handle sharing this property list, see Props::share()
+        DProps_ share() const {
+            return refcount() ? DProps_(ref()) : DProps_(*this);
+        }
+        ~DProps_() {
+            if (id) close();
+        }
+        void close() {
+            H5Pclose(id); id = 0;
+        }
+        //chainable property setters:
+        //eg. DProps().chunked().deflate(3).shuffle();
         DProps_& compact() {
             check(H5Pset_layout(id, H5D_COMPACT));
             return *this;
@@ -587,7 +1870,7 @@ namespace H5TL {
                 //data size -> chunk size: 1 MB -> 1 line, 1 TB -> 1k lines
                 //                         2^0  -> 2^0,   2^20 -> 2^10
                 //  chunk_size = 2^(log2(data_mb)*10/20)*line_size = sqrt(data_mb)*line_size
-                chunk_nbytes = size_t(sqrt(data_mb))*line_nbytes;
+                chunk_nbytes = size_t(std::sqrt(double(data_mb)))*line_nbytes;
             }
             //given chunk_nbytes, how many items should be in the chunk?
             size_t desired_chunk_size(chunk_nbytes / item_nbytes);
@@ -611,6 +1894,10 @@ namespace H5TL {
             //the minimum chunk shape is a 1 in every dimension
             return chunked(chunk_shape);
         }
+        ///Set the chunk shape chosen by planner, see ChunkPlanner
+        DProps_& chunked(const ChunkPlanner& planner) {
+            return chunked(planner.plan());
+        }
         DProps_& fill(const void* value, const DType& value_type) {
             check(H5Pset_fill_value(id, value_type, value));
             return *this;
@@ -636,9 +1923,77 @@ namespace H5TL {
             check(H5Pset_shuffle(id));
             return *this;
         }
+        /** \brief Store values with only the bits they need, relative to the minimum of each chunk (lossy for floats)
+        *
+        * \param type H5Z_SO_FLOAT_DSCALE to keep factor decimal digits of floats, or H5Z_SO_INT to keep factor bits of
+        *  integers (0 to work out the bits needed for each chunk, which is lossless)
+        * \param factor Decimal digits or bits to keep
+        */
+        DProps_& scale_offset(H5Z_SO_scale_type_t type = H5Z_SO_INT, int factor = H5Z_SO_INT_MINBITS_DEFAULT) {
+            check(H5Pset_scaleoffset(id, type, factor));
+            return *this;
+        }
+        ///Store only the significant bits of each value, as set by DType::precision() on the dataset's type
+        DProps_& nbit() {
+            check(H5Pset_nbit(id));
+            return *this;
+        }
+        /** \brief Add a filter by id, with its parameters -- see H5TL::filters for the ids DProps has setters for.
+        *
+        * A mandatory filter (without H5Z_FLAG_OPTIONAL in flags) is checked now, and throws if the library can't use it.
+        */
+        DProps_& filter(H5Z_filter_t filter_id, unsigned int flags = H5Z_FLAG_MANDATORY, const std::vector<unsigned int>& cd_values = std::vector<unsigned int>()) {
+            if (!(flags & H5Z_FLAG_OPTIONAL))
+                filters::require(filter_id);
+            check(H5Pset_filter(id, filter_id, flags, cd_values.size(), cd_values.data()));
+            return *this;
+        }
+        ///Zstandard compression, level 1 (fastest) to 22
+        DProps_& zstd(int level = 3) {
+            return filter(filters::ZSTD, H5Z_FLAG_MANDATORY, { unsigned(level) });
+        }
+        ///LZ4 compression, in blocks of block_nbytes (0 for the whole chunk)
+        DProps_& lz4(unsigned int block_nbytes = 0) {
+            return filter(filters::LZ4, H5Z_FLAG_MANDATORY, { block_nbytes });
+        }
+        /** \brief Blosc compression
+        * \param level 0 (none) to 9
+        * \param shuffle 0 for none, 1 for byte shuffle, 2 for bit shuffle
+        * \param compressor 0 blosclz, 1 lz4, 2 lz4hc, 3 snappy, 4 zlib, 5 zstd
+        */
+        DProps_& blosc(unsigned int level = 5, unsigned int shuffle = 1, unsigned int compressor = 0) {
+            //the first four values are filled in by the filter
+            return filter(filters::BLOSC, H5Z_FLAG_MANDATORY, { 0, 0, 0, 0, level, shuffle, compressor });
+        }
+        /** \brief Bitshuffle, optionally followed by compression
+        * \param compression 0 for none, 2 for lz4, 3 for zstd (bitshuffle 0.4 and later)
+        * \param level zstd compression level
+        * \param block_size elements per block, 0 to let the filter choose
+        */
+        DProps_& bitshuffle(unsigned int compression = 2, unsigned int level = 3, unsigned int block_size = 0) {
+            //the first three values are filled in by the filter
+            std::vector<unsigned int> cd_values = { 0, 0, 0, block_size, compression };
+            if (compression == 3) cd_values.push_back(level);
+            return filter(filters::BITSHUFFLE, H5Z_FLAG_MANDATORY, cd_values);
+        }
+        ///Throw an h5tl_error naming the first filter in this list the library can't use, see filters::require()
+        void require_filters() const {
+            int n = H5Pget_nfilters(id);
+            for (int i = 0; i < n; ++i) {
+                unsigned int flags = 0;
+                size_t cd_nelmts = 0;
+                char name[256] = "";
+                H5Z_filter_t f = H5Pget_filter2(id, unsigned(i), &flags, &cd_nelmts, nullptr, sizeof(name), name, nullptr);
+                if (f < 0) util::throw_error();
+                filters::require(f, name);
+            }
+        }
         bool is_chunked() const {
             return H5Pget_layout(id) == H5D_CHUNKED;
         }
+        bool is_virtual() const {
+            return H5Pget_layout(id) == H5D_VIRTUAL;
+        }
         std::vector<hsize_t> chunk() const {
             int n = H5Pget_chunk(id, 0, nullptr);
             if (n <= 0)
@@ -652,6 +2007,213 @@ namespace H5TL {
     template<typename XX>
     const DProps DProps_<XX>::DEFAULT = DProps(H5P_DATASET_CREATE_DEFAULT);
 
+    //file access properties
+    template<typename XX>
+    class FAProps_ : public Props {
+        FAProps_(hid_t id) : Props(id) {}
+    public:
+        static const FAProps_<void> DEFAULT;
+        FAProps_() : Props(H5P_FILE_ACCESS, 0) {}
+        //copy
+        FAProps_(const FAProps_ &fp) : Props(fp) {}
+        FAProps_& operator=(const FAProps_& fp) {
+            FAProps_ tmp(fp);
+            swap(tmp);
+            return *this;
+        }
+        //move
+        FAProps_(FAProps_ &&fp) noexcept : Props(std::move(fp)) {}
+        FAProps_& operator=(FAProps_&& fp) {
+            steal(fp);
+            return *this;
+        }
+        ///Return a handle sharing this property list, see Props::share()
+        FAProps_ share() const {
+            return refcount() ? FAProps_(ref()) : FAProps_(*this);
+        }
+        ~FAProps_() {}
+        FAProps_& libver_bounds(H5F_libver_t low, H5F_libver_t high) {
+            check(H5Pset_libver_bounds(id, low, high));
+            return *this;
+        }
+        ///Use the latest file format, which SWMR access requires
+        FAProps_& libver_latest() {
+            return libver_bounds(H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
+        }
+        /** \brief Keep the file in memory, with the core driver
+        * \param increment Bytes to grow the file's memory by at a time
+        * \param backing_store Whether to write the file to disk when it is closed
+        */
+        FAProps_& core(size_t increment = size_t(1) << 20, bool backing_store = false) {
+            check(H5Pset_fapl_core(id, increment, backing_store));
+            return *this;
+        }
+        ///Open the file from a copy of an image of it in memory, see File::from_bytes()
+        FAProps_& file_image(const void* data, size_t nbytes) {
+            check(H5Pset_file_image(id, const_cast<void*>(data), nbytes));
+            return *this;
+        }
+#ifdef H5TL_PARALLEL
+        /** \brief Open the file on every rank of comm, with the MPI-IO driver
+        *
+        * Opening, creating and closing the file, and creating or resizing datasets in it, are then collective: every
+        * rank must make the same calls in the same order.
+        */
+        FAProps_& mpio(MPI_Comm comm, MPI_Info info = MPI_INFO_NULL) {
+            check(H5Pset_fapl_mpio(id, comm, info));
+            return *this;
+        }
+#endif
+    };
+
+    template<typename XX>
+    const FAProps FAProps_<XX>::DEFAULT = FAProps(H5P_FILE_ACCESS_DEFAULT);
+
+    //dataset transfer properties, see Dataset::transfer()
+    template<typename XX>
+    class XProps_ : public Props {
+        friend class Dataset;
+        XProps_(hid_t id) : Props(id) {}
+    public:
+        static const XProps_<void> DEFAULT;
+        XProps_() : Props(H5P_DATASET_XFER, 0) {}
+        //copy
+        XProps_(const XProps_ &xp) : Props(xp) {}
+        XProps_& operator=(const XProps_& xp) {
+            XProps_ tmp(xp);
+            swap(tmp);
+            return *this;
+        }
+        //move
+        XProps_(XProps_ &&xp) noexcept : Props(std::move(xp)) {}
+        XProps_& operator=(XProps_&& xp) {
+            steal(xp);
+            return *this;
+        }
+        ///Return a handle sharing this property list, see Props::share()
+        XProps_ share() const {
+            return refcount() ? XProps_(ref()) : XProps_(*this);
+        }
+        ~XProps_() {}
+        /** \brief Size the buffers HDF5 converts types in, and optionally provide them, eg. page-aligned from aligned_vector<char, 4096>
+        *
+        * Reads and writes that convert types do so nbytes at a time (1 MB by default). Buffers passed here must hold nbytes
+        * and outlive every use of these properties; otherwise HDF5 allocates its own.
+        * \param tconv The type conversion buffer
+        * \param background The background buffer, used converting compound types
+        */
+        XProps_& buffer(size_t nbytes, void* tconv = nullptr, void* background = nullptr) {
+            check(H5Pset_buffer(id, nbytes, tconv, background));
+            return *this;
+        }
+#ifdef H5TL_PARALLEL
+        ///Read and write with collective MPI-IO: every rank must make the same read or write calls, though each may select different data, or none
+        XProps_& collective() {
+            check(H5Pset_dxpl_mpio(id, H5FD_MPIO_COLLECTIVE));
+            return *this;
+        }
+        ///Read and write with independent MPI-IO, the default
+        XProps_& independent() {
+            check(H5Pset_dxpl_mpio(id, H5FD_MPIO_INDEPENDENT));
+            return *this;
+        }
+#endif
+    };
+
+    template<typename XX>
+    const XProps XProps_<XX>::DEFAULT = XProps(H5P_DATASET_XFER_DEFAULT);
+
+    //dataset access properties, see Group::dataset(). A virtual dataset opens its sources with its own access properties
+    template<typename XX>
+    class DAProps_ : public Props {
+        DAProps_(hid_t id) : Props(id) {}
+    public:
+        static const DAProps_<void> DEFAULT;
+        DAProps_() : Props(H5P_DATASET_ACCESS, 0) {}
+        //copy
+        DAProps_(const DAProps_ &dp) : Props(dp) {}
+        DAProps_& operator=(const DAProps_& dp) {
+            DAProps_ tmp(dp);
+            swap(tmp);
+            return *this;
+        }
+        //move
+        DAProps_(DAProps_ &&dp) noexcept : Props(std::move(dp)) {}
+        DAProps_& operator=(DAProps_&& dp) {
+            steal(dp);
+            return *this;
+        }
+        ///Return a handle sharing this property list, see Props::share()
+        DAProps_ share() const {
+            return refcount() ? DAProps_(ref()) : DAProps_(*this);
+        }
+        ~DAProps_() {}
+        /** \brief Size the chunk cache of the dataset, which otherwise is the file's (1 MB by default)
+        * \param nbytes Bytes of decompressed chunks to keep. Reads of chunks that fit are cached whole
+        * \param nslots Hash table slots, ideally a prime about 100 times the number of chunks that fit in nbytes
+        * \param w0 Preference, from 0 to 1, for evicting chunks that have been read completely
+        */
+        DAProps_& chunk_cache(size_t nbytes, size_t nslots = 12421, double w0 = 0.75) {
+            check(H5Pset_chunk_cache(id, nslots, nbytes, w0));
+            return *this;
+        }
+        /** \brief Choose the extent of a virtual dataset with unlimited mappings
+        * \param view H5D_VDS_LAST_AVAILABLE (the default) to reach the end of the furthest source, or
+        * H5D_VDS_FIRST_MISSING to stop where the first source is missing
+        */
+        DAProps_& virtual_view(H5D_vds_view_t view) {
+            check(H5Pset_virtual_view(id, view));
+            return *this;
+        }
+        ///The number of missing source files a printf-style mapping skips over before it stops looking for more
+        DAProps_& virtual_printf_gap(hsize_t gap) {
+            check(H5Pset_virtual_printf_gap(id, gap));
+            return *this;
+        }
+        ///Look for a virtual dataset's relative source file names in directory prefix, instead of next to its own file
+        DAProps_& virtual_prefix(const std::string& prefix) {
+            check(H5Pset_virtual_prefix(id, prefix.c_str()));
+            return *this;
+        }
+    };
+
+    template<typename XX>
+    const DAProps DAProps_<XX>::DEFAULT = DAProps(H5P_DATASET_ACCESS_DEFAULT);
+
+#ifdef H5TL_PARALLEL
+    //agreement between the ranks of a communicator, for the collective Group::createDataset() and Dataset::append()
+    namespace parallel {
+        static_assert(sizeof(hsize_t) == sizeof(unsigned long long), "hsize_t is sent to MPI as unsigned long long");
+
+        inline void check(int err, const char* call) {
+            if (err != MPI_SUCCESS)
+                throw std::runtime_error(std::string(call) + " failed.");
+        }
+        //the largest of each element of v on any rank
+        inline std::vector<hsize_t> max(MPI_Comm comm, std::vector<hsize_t> v) {
+            check(MPI_Allreduce(MPI_IN_PLACE, v.data(), int(v.size()), MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm), "MPI_Allreduce");
+            return v;
+        }
+        //throws on every rank unless every rank passes the same n
+        inline void same(MPI_Comm comm, long long n, const std::string& what) {
+            long long range[2] = { n, -n };
+            check(MPI_Allreduce(MPI_IN_PLACE, range, 2, MPI_LONG_LONG, MPI_MAX, comm), "MPI_Allreduce");
+            if (range[0] != -range[1])
+                throw std::runtime_error("Ranks disagree on " + what + ".");
+        }
+        //the number of rows on the ranks before this one, and on all ranks
+        inline void count(MPI_Comm comm, hsize_t rows, hsize_t& before, hsize_t& total) {
+            unsigned long long n = rows, b = 0, t = 0;
+            int rank;
+            check(MPI_Comm_rank(comm, &rank), "MPI_Comm_rank");
+            check(MPI_Exscan(&n, &b, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm), "MPI_Exscan");
+            check(MPI_Allreduce(&n, &t, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm), "MPI_Allreduce");
+            before = rank ? hsize_t(b) : 0; //MPI_Exscan leaves rank 0's result undefined
+            total = hsize_t(t);
+        }
+    }
+#endif
+
     template<typename XX>
     class DSpace_ : public ID {
         friend class Dataset;
@@ -668,16 +2230,24 @@ namespace H5TL {
         DSpace_() : ID(H5Screate(H5S_SCALAR)) {}
         //copy
         DSpace_(const DSpace_ &ds) : ID(H5Scopy(ds)) {}
-        DSpace_& operator=(DSpace_ ds) {
-            swap(ds);
+        DSpace_& operator=(const DSpace_& ds) {
+            DSpace_ tmp(ds);
+            swap(tmp);
             return *this;
         }
         //move
-        DSpace_(DSpace_ &&ds) : ID(std::move(ds)) {}
+        DSpace_(DSpace_ &&ds) noexcept : ID(std::move(ds)) {}
         DSpace_& operator=(DSpace_&& ds) {
             steal(ds);
             return *this;
         }
+        /** \brief Return a handle sharing this dataspace, rather than a copy of it.
+        *
+        * Both handles refer to the same HDF5 dataspace, including its selection.
+        */
+        DSpace_ share() const {
+            return DSpace_(ref());
+        }
         //construct simple
         DSpace_(size_t N, const hsize_t *shape, const hsize_t *maxshape = nullptr) : ID(0) {
             init(N, shape, maxshape);
@@ -697,7 +2267,7 @@ namespace H5TL {
             if (id) close();
         }
         void close() {
-            check(H5Sclose(id));
+            check(H5Sclose(id)); id = 0;
         }
         template<typename selection_t>
         DSpace_& select(const selection_t& s) {
@@ -793,6 +2363,9 @@ namespace H5TL {
         Hyperslab(const Hyperslab& h) : Selection(h), start(h.start), stride(h.stride), count(h.count), block(h.block) {}
         Hyperslab(Hyperslab&& h) : Selection(std::move(h)), start(std::move(h.start)), stride(std::move(h.stride)), count(std::move(h.count)), block(std::move(h.block)) {}
         Hyperslab(const std::vector<hsize_t>& start, const std::vector<hsize_t>& count) : start(start), count(count) {}
+        ///count blocks of block items, stride items apart. A count of H5S_UNLIMITED repeats without end, for virtual datasets
+        Hyperslab(const std::vector<hsize_t>& start, const std::vector<hsize_t>& count, const std::vector<hsize_t>& stride, const std::vector<hsize_t>& block)
+            : start(start), stride(stride), count(count), block(block) {}
         template<size_t N>
         Hyperslab(const hsize_t(&start)[N], const hsize_t(&count)[N]) : start(start, start + N), count(count, count + N) {}
         virtual void set(DSpace& ds) const {
@@ -805,6 +2378,198 @@ namespace H5TL {
         return DSpace(H5TL::shape(d));
     }
 
+    namespace detail {
+        //how HDF5 sees memory of a shape laid out with strides: a hyperslab of a C-ordered space, or if the layout isn't
+        //one, a space of n elements to be gathered into or scattered from a C-ordered copy (staged)
+        struct strided_layout {
+            DSpace space;
+            bool staged;
+            std::vector<hsize_t> shape;
+            std::vector<hssize_t> strides;
+        };
+        //visit the elements of a strided layout in C order: f(offset of the first element of a row, row length, row stride)
+        template<typename F>
+        void for_each_row(const std::vector<hsize_t>& shape, const std::vector<hssize_t>& strides, F f) {
+            size_t r = shape.size();
+            std::vector<hsize_t> index(r, 0);
+            hsize_t offset = 0, rows = util::product(shape.begin(), shape.end() - 1, hsize_t(1));
+            for (hsize_t i = 0; i < rows; ++i) {
+                f(offset, shape[r - 1], strides[r - 1]);
+                //step the outer index like an odometer
+                for (size_t k = r - 1; k-- > 0;) {
+                    offset += hsize_t(strides[k]);
+                    if (++index[k] < shape[k]) break;
+                    offset -= hsize_t(strides[k]) * shape[k];
+                    index[k] = 0;
+                }
+            }
+        }
+        //visit the planes of the last two dimensions of a strided layout, in C order:
+        //f(offset of the plane's first element, rows, columns, row stride, column stride)
+        template<typename F>
+        void for_each_plane(const std::vector<hsize_t>& shape, const std::vector<hssize_t>& strides, F f) {
+            size_t r = shape.size();
+            if (r == 1) {
+                f(hsize_t(0), hsize_t(1), shape[0], hssize_t(0), strides[0]);
+                return;
+            }
+            std::vector<hsize_t> index(r - 2, 0);
+            hsize_t offset = 0, planes = util::product(shape.begin(), shape.end() - 2, hsize_t(1));
+            for (hsize_t i = 0; i < planes; ++i) {
+                f(offset, shape[r - 2], shape[r - 1], strides[r - 2], strides[r - 1]);
+                for (size_t k = r - 2; k-- > 0;) {
+                    offset += hsize_t(strides[k]);
+                    if (++index[k] < shape[k]) break;
+                    offset -= hsize_t(strides[k]) * shape[k];
+                    index[k] = 0;
+                }
+            }
+        }
+        //copy between strided memory and a C-ordered copy, a tile at a time so that transposes stay in cache
+        template<typename T>
+        void stage_planes(const strided_layout& l, T* memory, T* packed, bool scatter) {
+            const hsize_t tile = 64 / sizeof(T) < 8 ? 8 : 64 / sizeof(T);
+            for_each_plane(l.shape, l.strides, [&](hsize_t offset, hsize_t rows, hsize_t cols, hssize_t rs, hssize_t cs) {
+                T* plane = memory + offset;
+                for (hsize_t i0 = 0; i0 < rows; i0 += tile) {
+                    hsize_t i1 = std::min(rows, i0 + tile);
+                    for (hsize_t j0 = 0; j0 < cols; j0 += tile) {
+                        hsize_t j1 = std::min(cols, j0 + tile);
+                        for (hsize_t i = i0; i < i1; ++i) {
+                            T* m = plane + hssize_t(i) * rs;
+                            T* p = packed + i * cols;
+                            if (scatter) {
+                                for (hsize_t j = j0; j < j1; ++j)
+                                    m[hssize_t(j) * cs] = p[j];
+                            }
+                            else {
+                                for (hsize_t j = j0; j < j1; ++j)
+                                    p[j] = m[hssize_t(j) * cs];
+                            }
+                        }
+                    }
+                }
+                packed += rows * cols;
+            });
+        }
+        //copy the elements of a staged layout from memory to a C-ordered copy, or back if scatter
+        inline void stage(const strided_layout& l, size_t sz, const char* from, char* to, bool scatter) {
+            char* memory = (char*)(scatter ? to : from);
+            char* packed = (char*)(scatter ? from : to);
+            switch (sz) {
+            case 1: return stage_planes(l, (uint8_t*)memory, (uint8_t*)packed, scatter);
+            case 2: return stage_planes(l, (uint16_t*)memory, (uint16_t*)packed, scatter);
+            case 4: return stage_planes(l, (uint32_t*)memory, (uint32_t*)packed, scatter);
+            case 8: return stage_planes(l, (uint64_t*)memory, (uint64_t*)packed, scatter);
+            }
+            char* o = to;
+            const char* i = from;
+            for_each_row(l.shape, l.strides, [&](hsize_t offset, hsize_t n, hssize_t stride) {
+                for (hsize_t j = 0; j < n; ++j) {
+                    size_t at = size_t(offset + j * stride) * sz;
+                    if (scatter) { std::memcpy(to + at, i, sz); i += sz; }
+                    else { std::memcpy(o, from + at, sz); o += sz; }
+                }
+            });
+        }
+        inline strided_layout layout(const std::vector<hsize_t>& shape, std::vector<hssize_t> strides) {
+            size_t r = shape.size();
+            if (strides.size() != r)
+                throw std::runtime_error("strides must have one entry for each dimension of the shape.");
+            if (std::any_of(strides.begin(), strides.end(), [](hssize_t s) { return s < 0; }))
+                throw std::runtime_error("Cannot read or write data with negative strides: copy it first.");
+            if (r == 0 || util::product(shape.begin(), shape.end(), hsize_t(1)) == 0)
+                return { DSpace(shape), false, shape, strides };
+            //the stride of a dimension of size 1 doesn't matter: make it just past the dimension inside it
+            hssize_t c_stride = 1;
+            bool contiguous = true;
+            for (size_t k = r; k-- > 0;) {
+                if (shape[k] == 1) strides[k] = k + 1 < r ? strides[k + 1] * hssize_t(shape[k + 1]) : 1;
+                contiguous = contiguous && strides[k] == c_stride;
+                c_stride *= hssize_t(shape[k]);
+            }
+            if (contiguous)
+                return { DSpace(shape), false, shape, strides };
+            //a block of a C-ordered array with extent: each stride a multiple of the next, and each row fits in the next
+            std::vector<hsize_t> extent(r), stride(r, 1), start(r, 0), block(r, 1);
+            bool nested = strides[r - 1] > 0;
+            stride[r - 1] = hsize_t(strides[r - 1]);
+            extent[0] = shape[0];
+            if (r == 1) {
+                extent[0] = stride[0] * (shape[0] - 1) + 1;
+            }
+            else {
+                extent[r - 1] = hsize_t(strides[r - 2]);
+                nested = nested && stride[r - 1] * (shape[r - 1] - 1) < extent[r - 1];
+                for (size_t k = 1; k + 1 < r && nested; ++k) {
+                    nested = strides[k] > 0 && strides[k - 1] % strides[k] == 0;
+                    extent[k] = nested ? hsize_t(strides[k - 1] / strides[k]) : 0;
+                    nested = nested && shape[k] <= extent[k];
+                }
+            }
+            if (nested) {
+                DSpace memory(extent);
+                check(H5Sselect_hyperslab(memory, H5S_SELECT_SET, start.data(), stride.data(), shape.data(), block.data()));
+                return { std::move(memory), false, shape, strides };
+            }
+            //any other layout is staged
+            return { DSpace({ util::product(shape.begin(), shape.end(), hsize_t(1)) }), true, shape, strides };
+        }
+    }
+    /** \brief A memory space for data of the given shape laid out with strides, in elements, instead of in C order.
+    *
+    * Data that is a block of a larger C-ordered array, eg. a slice or an image region, is selected as a hyperslab of
+    * that array, so HDF5 gathers and scatters it in place. Other layouts, eg. column-major or transposed data, select
+    * each element by its offset in a 1-dimensional space, in C order of the shape: Dataset reads and writes don't use
+    * that selection, which HDF5 is slow to build and follow, but go through a C-ordered copy. Strides may not be negative.
+    */
+    inline DSpace strided_space(const std::vector<hsize_t>& shape, const std::vector<hssize_t>& strides) {
+        detail::strided_layout l = detail::layout(shape, strides);
+        if (!l.staged)
+            return std::move(l.space);
+        std::vector<hsize_t> offsets;
+        detail::for_each_row(l.shape, l.strides, [&](hsize_t offset, hsize_t n, hssize_t stride) {
+            for (hsize_t j = 0; j < n; ++j)
+                offsets.push_back(offset + j * hsize_t(stride));
+        });
+        DSpace memory({ *std::max_element(offsets.begin(), offsets.end()) + 1 });
+        check(H5Sselect_elements(memory, H5S_SELECT_SET, offsets.size(), offsets.data()));
+        return memory;
+    }
+    namespace detail {
+        //whether adapt<data_t> has the optional strides() member
+        template<typename data_t>
+        struct has_strides {
+            template<typename T> static auto test(int) -> decltype(adapt<T>::strides(std::declval<const T&>()), std::true_type());
+            template<typename T> static std::false_type test(...);
+            static const bool value = decltype(test<data_t>(0))::value;
+        };
+    }
+    ///The dataspace of the memory holding d: its shape, or a strided_space() if adapt<data_t> has strides()
+    template<typename data_t>
+    typename std::enable_if<!detail::has_strides<data_t>::value, DSpace>::type memory_space(const data_t& d) {
+        return H5TL::space(d);
+    }
+    template<typename data_t>
+    typename std::enable_if<detail::has_strides<data_t>::value, DSpace>::type memory_space(const data_t& d) {
+        return strided_space(H5TL::shape(d), adapt<data_t>::strides(d));
+    }
+    namespace detail {
+        //the layout Dataset reads and writes d with
+        template<typename data_t>
+        typename std::enable_if<!has_strides<data_t>::value, strided_layout>::type memory_layout(const data_t& d) {
+            return { H5TL::space(d), false, {}, {} };
+        }
+        template<typename data_t>
+        typename std::enable_if<has_strides<data_t>::value, strided_layout>::type memory_layout(const data_t& d) {
+            return layout(H5TL::shape(d), adapt<data_t>::strides(d));
+        }
+        //whether l is plain C-ordered memory, which can be copied as it is
+        inline bool in_c_order(const strided_layout& l) {
+            return !l.staged && H5Sget_select_type(l.space) == H5S_SEL_ALL;
+        }
+    }
+
     //Attributes
     class Attribute : public ID {
         friend class Object;
@@ -812,40 +2577,48 @@ namespace H5TL {
         Attribute(hid_t id) : ID(id) {}
     public:
         Attribute() : ID(0) {}
-        //no copy!
+        //copy shares the attribute
+        Attribute(const Attribute &attr) : ID(attr.ref()) {}
+        Attribute& operator=(const Attribute& a) {
+            Attribute tmp(a);
+            steal(tmp);
+            return *this;
+        }
         //move
-        Attribute(Attribute &&attr) : ID(std::move(attr)) {}
+        Attribute(Attribute &&attr) noexcept : ID(std::move(attr)) {}
         Attribute& operator=(Attribute&& a) {
             steal(a);
             return *this;
         }
-        virtual ~Attribute() {
+        ~Attribute() {
             if (id) close();
         }
-        virtual void close() {
-            check(H5Aclose(id)); id = 0;
+        void close() {
+            check(H5TL_PROFILED_CLOSE("H5Aclose", id, H5Aclose(id))); id = 0;
         }
         std::string name() {
-            ssize_t len = check_ssize(H5Aget_name(id, 0, nullptr));
+            ssize_t len = check_ssize(H5TL_PROFILED("H5Aget_name", id, 0, H5Aget_name(id, 0, nullptr)));
             std::string tmp(len, '\0');
-            check_ssize(H5Aget_name(id, len, &(tmp[0])));
+            check_ssize(H5TL_PROFILED("H5Aget_name", id, 0, H5Aget_name(id, len, &(tmp[0]))));
             return tmp;
         }
         DType dtype() {
-            return DType(H5Aget_type(id));
+            return DType(H5TL_PROFILED("H5Aget_type", id, 0, H5Aget_type(id)));
         }
         DSpace space() {
-            return DSpace(H5Aget_space(id));
+            return DSpace(H5TL_PROFILED("H5Aget_space", id, 0, H5Aget_space(id)));
         }
         void write(const void* buffer, const DType &buffer_type) {
-            check(H5Awrite(id, buffer_type, buffer));
+            check(H5TL_PROFILED(profile::converts(H5Aget_type(id), buffer_type) ? "H5Awrite (convert)" : "H5Awrite",
+                id, profile::attribute_nbytes(id, buffer_type), H5Awrite(id, buffer_type, buffer)));
         }
         template<typename data_t>
         void write(const data_t& buffer) {
             write(H5TL::data(buffer), H5TL::dtype(buffer));
         }
         void read(void* buffer, const DType &buffer_type) {
-            check(H5Aread(id, buffer_type, buffer));
+            check(H5TL_PROFILED(profile::converts(H5Aget_type(id), buffer_type) ? "H5Aread (convert)" : "H5Aread",
+                id, profile::attribute_nbytes(id, buffer_type), H5Aread(id, buffer_type, buffer)));
         }
         template<typename data_t>
         void read(data_t& buffer) {
@@ -865,32 +2638,46 @@ namespace H5TL {
 
     //Object
     //Files, Groups, Datasets
+    //Copying an Object shares the HDF5 id: the copies refer to the same open object, which is closed when the last
+    //copy is closed. Copies may be handed to other threads or stored in containers.
     class Object : public ID {
     protected:
         Object() : ID(0) {}
         Object(hid_t id) : ID(id) {}
     public:
-        //no copy!
+        //copy
+        Object(const Object &obj) : ID(obj.ref()) {}
+        Object& operator=(const Object& obj) {
+            Object tmp(obj);
+            steal(tmp);
+            return *this;
+        }
         //move
-        Object(Object &&loc) : ID(std::move(loc)) {}
+        Object(Object &&loc) noexcept : ID(std::move(loc)) {}
         Object& operator=(Object&& obj) {
             steal(obj);
             return *this;
         }
-        virtual ~Object() {}
+        ~Object() {}
 
-        virtual bool exists() {
-            return check_tri(H5Oexists_by_name(id, ".", H5P_LINK_ACCESS_DEFAULT));
+        bool exists() {
+            return check_tri(H5TL_PROFILED("H5Oexists_by_name", id, 0, H5Oexists_by_name(id, ".", H5P_LINK_ACCESS_DEFAULT)));
         }
         //attributes:
         bool hasAttribute(const std::string& name) {
-            return check_tri(H5Aexists(id, name.c_str()));
+            return check_tri(H5TL_PROFILED("H5Aexists", id, 0, H5Aexists(id, name.c_str())));
         }
         Attribute createAttribute(const std::string& name, const DType& type, const DSpace& space) {
-            return Attribute(H5Acreate(id, name.c_str(), type, space, H5P_ATTRIBUTE_CREATE_DEFAULT, H5P_DEFAULT));
+            return Attribute(H5TL_PROFILED("H5Acreate", id, 0, H5Acreate(id, name.c_str(), type, space, H5P_ATTRIBUTE_CREATE_DEFAULT, H5P_DEFAULT)));
         }
         Attribute attribute(const std::string& name) {
-            return Attribute(H5Aopen(id, name.c_str(), H5P_DEFAULT));
+            return Attribute(H5TL_PROFILED("H5Aopen", id, 0, H5Aopen(id, name.c_str(), H5P_DEFAULT)));
+        }
+        ///open an attribute, returning the error instead of throwing it
+        result<Attribute> try_attribute(const std::string& name) noexcept {
+            hid_t a = H5TL_PROFILED("H5Aopen", id, 0, H5Aopen(id, name.c_str(), H5P_DEFAULT));
+            if (a < 0) return result<Attribute>::failure();
+            return Attribute(a);
         }
         Attribute writeAttribute(const std::string& name, const void* buffer, const DType& buffer_type, const DSpace& space) {
             Attribute tmp = createAttribute(name, buffer_type, space);
@@ -916,102 +2703,535 @@ namespace H5TL {
         }
     };
 
-    class Dataset : public Object {
-        friend class Group;
+    /** \brief The summary of one chunk of a dataset, kept by Dataset::track_stats()
+    */
+    struct ChunkStats {
+        double min, max, sum; ///< of the items that aren't NaN: min is +inf and max is -inf if there are none
+        uint64_t count, nan_count; ///< the items summarized, and how many are NaN. Rows added by growing the dataset count once written
+        bool known; ///< false if the chunk hasn't been summarized, so nothing is known about its items
+    };
+
+    /** \brief A range of values to find with Dataset::query()
+    *
+    * Any type with the same two members may be given to query() instead: operator() tests one item, and may_match()
+    * says whether a chunk with the given stats could hold an item that passes the test.
+    */
+    class Predicate {
     protected:
-        Dataset(hid_t id) : Object(id) {}
+        double lo, hi;
+        bool lo_open, hi_open;
+        Predicate(double lo, bool lo_open, double hi, bool hi_open) : lo(lo), hi(hi), lo_open(lo_open), hi_open(hi_open) {}
     public:
-        Dataset() : Object() {}
-        //no copy!
-        //move
-        Dataset(Dataset &&dset) : Object(std::move(dset)) {}
-        Dataset& operator=(Dataset&& dset) {
-            steal(dset);
-            return *this;
+        static Predicate above(double x) { return Predicate(x, true, INFINITY, false); }
+        static Predicate at_least(double x) { return Predicate(x, false, INFINITY, false); }
+        static Predicate below(double x) { return Predicate(-INFINITY, false, x, true); }
+        static Predicate at_most(double x) { return Predicate(-INFINITY, false, x, false); }
+        ///lo <= x <= hi
+        static Predicate between(double lo, double hi) { return Predicate(lo, false, hi, false); }
+        static Predicate equal(double x) { return Predicate(x, false, x, false); }
+        //NaN compares false both ways, so it never matches
+        bool operator()(double x) const {
+            return (lo_open ? x > lo : x >= lo) && (hi_open ? x < hi : x <= hi);
+        }
+        bool may_match(const ChunkStats& s) const {
+            return s.count > s.nan_count && (lo_open ? s.max > lo : s.max >= lo) && (hi_open ? s.min < hi : s.min <= hi);
         }
-        virtual ~Dataset() {
-            if (id) close();
-        }
-        virtual void close() {
-            check(H5Dclose(id)); id = 0;
+    };
+
+    namespace detail {
+        //shared by every Dataset handle that tracks stats
+        struct stats_registry {
+            std::mutex mutex;
+            uint64_t generation = 0; //bumped by track_stats(), so lookups that raced it aren't cached
+            std::map<hid_t, bool> files; //whether each open file has tracked stats, by the id of its File handle
+            std::mutex rows; //held while a write reads, folds into and writes back a sidecar's rows
+        };
+        inline stats_registry& stats_state() {
+            static stats_registry r;
+            return r;
         }
-        DSpace space() {
-            return DSpace(H5Dget_space(id));
+        //forget a file whose handle was closed
+        inline void forget_stats_file(hid_t file) {
+            stats_registry& r = stats_state();
+            std::lock_guard<std::mutex> guard(r.mutex);
+            r.files.erase(file);
         }
-        DType dtype() {
-            return DType(H5Dget_type(id));
+    }
+
+    class Dataset : public Object {
+        friend class Group;
+    protected:
+        //transfer properties for reads and writes through this handle. Empty (H5P_DEFAULT) until transfer() is called,
+        //so opening a dataset doesn't make a property list
+        XProps xfer;
+        static XProps share_xfer(const XProps& x) {
+            return x ? x.share() : XProps(hid_t(H5P_DEFAULT));
+        }
+        //the chunk stats companion, looked up by stats_sidecar(). Empty if the dataset has none
+        std::shared_ptr<Dataset> stats;
+        Dataset(hid_t id) : Object(id), xfer(hid_t(H5P_DEFAULT)) {}
+        //the dataset's chunk shape, or its extent if it isn't chunked. No side is 0, so it can divide the extent
+        std::vector<hsize_t> chunk_or_extent(const std::vector<hsize_t>& extent) {
+            std::vector<hsize_t> chunk = props().chunk();
+            if (chunk.size() != extent.size())
+                chunk = extent;
+            for (hsize_t& c : chunk)
+                c = std::max<hsize_t>(c, 1);
+            return chunk;
+        }
+        //the number of chunks along each dimension
+        static std::vector<hsize_t> chunk_grid(const std::vector<hsize_t>& extent, const std::vector<hsize_t>& chunk) {
+            std::vector<hsize_t> grid(extent.size());
+            for (size_t d = 0; d < grid.size(); ++d)
+                grid[d] = (extent[d] + chunk[d] - 1) / chunk[d];
+            return grid;
+        }
+        //step pos to the next position in the box [lo, hi) in C order, returning false after the last
+        static bool next_position(std::vector<hsize_t>& pos, const std::vector<hsize_t>& lo, const std::vector<hsize_t>& hi) {
+            for (size_t d = pos.size(); d-- > 0;) {
+                if (++pos[d] < hi[d]) return true;
+                pos[d] = lo[d];
+            }
+            return false;
         }
-        DProps props() {
-            return DProps(H5Dget_create_plist(id));
+        //whether any dataset in the file tracks stats: track_stats() tags the root group with H5TL_stats. The answer is
+        //kept while the file's handle is open, so handles in a file without stats look once per file, not once each
+        bool file_tracks_stats() {
+            hid_t file = check_id(H5TL_PROFILED("H5Iget_file_id", id, 0, H5Iget_file_id(id)));
+            //with only our reference, the file's handle was closed and this id closes with it: don't keep the answer
+            bool keep = H5Iget_ref(file) > 1;
+            detail::stats_registry& r = detail::stats_state();
+            std::unique_lock<std::mutex> lock(r.mutex);
+            auto found = r.files.find(file);
+            bool tracked = true;
+            if (found != r.files.end()) {
+                tracked = found->second;
+            } else {
+                uint64_t generation = r.generation;
+                lock.unlock();
+                //on error, look at the dataset's own attribute
+                tracked = H5TL_PROFILED("H5Aexists_by_name", id, 0, H5Aexists_by_name(file, "/", "H5TL_stats", H5P_DEFAULT)) != 0;
+                lock.lock();
+                if (keep && generation == r.generation)
+                    r.files[file] = tracked;
+            }
+            lock.unlock();
+            H5Idec_ref(file);
+            return tracked;
+        }
+        //open the sidecar named by the H5TL_stats attribute, the first time this handle needs it.
+        //threads may share a handle to write disjoint regions (eg. Pyramid's workers), so it is loaded and stored atomically
+        std::shared_ptr<Dataset> stats_sidecar() {
+            std::shared_ptr<Dataset> s = std::atomic_load(&stats);
+            if (!s) {
+                s = std::make_shared<Dataset>();
+                if (file_tracks_stats() && hasAttribute("H5TL_stats")) {
+                    hobj_ref_t ref;
+                    readAttribute("H5TL_stats", &ref, DType::REFERENCE);
+                    *s = Dataset(check_id(H5TL_PROFILED("H5Rdereference2", id, 0, H5Rdereference2(id, H5P_DEFAULT, H5R_OBJECT, &ref))));
+                    s->stats = std::make_shared<Dataset>(); //which has no stats of its own
+                }
+                std::atomic_store(&stats, s);
+            }
+            return s->id ? s : nullptr;
+        }
+        //grow the sidecar to rows for every chunk of grid, which ends in the dimension of 5
+        static void fit_sidecar(Dataset& sidecar, const std::vector<hsize_t>& grid) {
+            std::vector<hsize_t> extent = sidecar.space().extent();
+            if (!std::equal(grid.begin(), grid.end(), extent.begin(), std::less_equal<hsize_t>()))
+                sidecar.extend(grid);
+        }
+        //read the chunk at pos of the grid as doubles, into values, and put its stats in row
+        void summarize_chunk(const std::vector<hsize_t>& pos, const std::vector<hsize_t>& extent, const std::vector<hsize_t>& chunk,
+            std::vector<double>& values, double* row) {
+            const size_t rank = pos.size();
+            std::vector<hsize_t> origin(rank), shape(rank);
+            for (size_t d = 0; d < rank; ++d) {
+                origin[d] = pos[d] * chunk[d];
+                shape[d] = std::min(chunk[d], extent[d] - origin[d]);
+            }
+            values.resize(size_t(util::product(shape.begin(), shape.end(), hsize_t(1))));
+            read(values.data(), DType::DOUBLE, DSpace(shape), Hyperslab(origin, shape));
+            double min = INFINITY, max = -INFINITY, sum = 0;
+            uint64_t nans = 0;
+            for (double v : values) {
+                if (std::isnan(v)) { ++nans; continue; }
+                min = std::min(min, v);
+                max = std::max(max, v);
+                sum += v;
+            }
+            row[0] = min; row[1] = max; row[2] = sum; row[3] = double(values.size()); row[4] = double(nans);
+        }
+        //recompute the stats of the chunks in the box [lo, hi) of the chunk grid
+        void summarize(Dataset& sidecar, const std::vector<hsize_t>& lo, const std::vector<hsize_t>& hi) {
+            H5TL_PROFILE_SCOPE("Dataset::summarize", id);
+            const size_t rank = lo.size();
+            std::vector<hsize_t> extent = space().extent(), chunk = chunk_or_extent(extent);
+            std::vector<hsize_t> grid = chunk_grid(extent, chunk), box(rank + 1, 5), start(lo);
+            for (size_t d = 0; d < rank; ++d)
+                box[d] = hi[d] - lo[d];
+            if (util::product(box.begin(), box.end(), hsize_t(1)) == 0)
+                return;
+            grid.push_back(5);
+            start.push_back(0);
+            std::vector<double> rows(size_t(util::product(box.begin(), box.end(), hsize_t(1)))), values;
+            std::vector<hsize_t> pos(lo);
+            std::lock_guard<std::mutex> guard(detail::stats_state().rows);
+            fit_sidecar(sidecar, grid);
+            double* row = rows.data();
+            do {
+                summarize_chunk(pos, extent, chunk, values, row);
+                row += 5;
+            } while (next_position(pos, lo, hi));
+            sidecar.write(rows.data(), DType::DOUBLE, DSpace(box), Hyperslab(start, box));
+        }
+        //after a write of buffer: fold the items it added after the counted rows of a chunk into that chunk's stats, and
+        //recompute the chunks it changed in any other way. The values are taken from buffer as the dataset stores them,
+        //so appending doesn't read anything back
+        void update_stats(Dataset& sidecar, const void* buffer, const DType& buffer_type, const DSpace& memory, const DSpace& file_space) {
+            H5TL_PROFILE_SCOPE("Dataset::update_stats", id);
+            int rank = H5Sget_simple_extent_ndims(file_space);
+            hssize_t n = H5Sget_select_npoints(file_space);
+            if (rank <= 0 || n <= 0)
+                return;
+            std::vector<hsize_t> extent = file_space.extent(), chunk = chunk_or_extent(extent);
+            std::vector<hsize_t> lo(rank), hi(rank), clo(rank), chi(rank), cbox(rank);
+            check(H5Sget_select_bounds(file_space, lo.data(), hi.data()));
+            for (int d = 0; d < rank; ++d) {
+                ++hi[d];
+                clo[d] = lo[d] / chunk[d];
+                chi[d] = (hi[d] - 1) / chunk[d] + 1;
+                cbox[d] = chi[d] - clo[d];
+            }
+            //points, or several blocks: read the chunks back
+            std::vector<hsize_t> box(rank);
+            std::transform(hi.begin(), hi.end(), lo.begin(), box.begin(), std::minus<hsize_t>());
+            if (util::product(box.begin(), box.end(), hsize_t(1)) != hsize_t(n)) {
+                summarize(sidecar, clo, chi);
+                return;
+            }
+            //the written items, converted as the dataset stored them, then to double
+            DType file_type = dtype();
+            aligned_vector<char> bytes(size_t(n) * std::max(std::max(buffer_type.size(), file_type.size()), sizeof(double)));
+            check(H5Dgather(memory, buffer, buffer_type, bytes.size(), bytes.data(), nullptr, nullptr));
+            if (!(buffer_type == file_type))
+                check(H5Tconvert(buffer_type, file_type, size_t(n), bytes.data(), nullptr, H5P_DEFAULT));
+            if (!(file_type == DType::DOUBLE))
+                check(H5Tconvert(file_type, DType::DOUBLE, size_t(n), bytes.data(), nullptr, H5P_DEFAULT));
+            //summarize them per chunk, a run of the last dimension at a time, split at the chunk edges
+            const double empty[5] = { INFINITY, -INFINITY, 0, 0, 0 };
+            std::vector<double> added;
+            for (hsize_t c = util::product(cbox.begin(), cbox.end(), hsize_t(1)); c > 0; --c)
+                added.insert(added.end(), empty, empty + 5);
+            const double* v = (const double*)bytes.data();
+            std::vector<hsize_t> pos(lo), runs(hi);
+            runs.back() = lo.back() + 1;
+            do {
+                size_t c = 0;
+                for (int d = 0; d + 1 < rank; ++d)
+                    c = c*size_t(cbox[d]) + size_t(pos[d] / chunk[d] - clo[d]);
+                for (hsize_t k = lo.back(); k < hi.back();) {
+                    hsize_t cl = k / chunk.back(), end = std::min(hi.back(), (cl + 1) * chunk.back());
+                    double* row = &added[(c*size_t(cbox.back()) + size_t(cl - clo.back())) * 5];
+                    row[3] += double(end - k);
+                    for (; k < end; ++k, ++v) {
+                        if (std::isnan(*v)) { ++row[4]; continue; }
+                        row[0] = std::min(row[0], *v);
+                        row[1] = std::max(row[1], *v);
+                        row[2] += *v;
+                    }
+                }
+            } while (next_position(pos, lo, runs));
+            std::vector<hsize_t> grid = chunk_grid(extent, chunk), start(clo), rows_box(cbox);
+            grid.push_back(5);
+            start.push_back(0);
+            rows_box.push_back(5);
+            std::vector<double> rows(added.size()), values;
+            //threads writing through a shared handle may touch the same chunk, and each folds into what the other wrote
+            std::lock_guard<std::mutex> guard(detail::stats_state().rows);
+            fit_sidecar(sidecar, grid);
+            sidecar.read(rows.data(), DType::DOUBLE, DSpace(rows_box), Hyperslab(start, rows_box));
+            std::vector<hsize_t> cpos(clo);
+            double* row = rows.data();
+            const double* add = added.data();
+            do {
+                //a known row counts the chunk's first rows along dimension 0. The write extends them if it starts just
+                //after them and covers every other dimension of the chunk
+                hsize_t origin = cpos[0] * chunk[0], inner = 1;
+                bool extends = !std::isnan(row[3]);
+                for (int d = 1; d < rank; ++d) {
+                    hsize_t o = cpos[d] * chunk[d], side = std::min(chunk[d], extent[d] - o);
+                    inner *= side;
+                    extends = extends && lo[d] <= o && hi[d] >= o + side;
+                }
+                uint64_t counted = extends ? uint64_t(row[3]) : 0;
+                if (extends && counted % inner == 0 && std::max(lo[0], origin) == origin + counted / inner) {
+                    row[0] = std::min(row[0], add[0]);
+                    row[1] = std::max(row[1], add[1]);
+                    row[2] += add[2];
+                    row[3] += add[3];
+                    row[4] += add[4];
+                } else {
+                    summarize_chunk(cpos, extent, chunk, values, row);
+                }
+                row += 5;
+                add += 5;
+            } while (next_position(cpos, clo, chi));
+            sidecar.write(rows.data(), DType::DOUBLE, DSpace(rows_box), Hyperslab(start, rows_box));
+        }
+        //after a resize. Chunks new along dimension 0 hold only fill values, so they count nothing yet, and an edge
+        //chunk that grew still counts its first rows: appends then extend both. Chunks cut by a shrink, or from the old
+        //edge of another resized dimension onwards, hold items the stats don't count, so they're unknown until written
+        void forget_stats(Dataset& sidecar, const std::vector<hsize_t>& before, const std::vector<hsize_t>& after) {
+            const size_t rank = after.size();
+            std::vector<hsize_t> chunk = chunk_or_extent(after), grid = chunk_grid(after, chunk), old_grid = chunk_grid(before, chunk);
+            bool cut = false;
+            for (size_t d = 0; d < rank; ++d)
+                cut = cut || (before[d] != after[d] && (d > 0 || after[d] < before[d]));
+            //an append within the edge chunk changes nothing
+            if (!cut && grid[0] == old_grid[0])
+                return;
+            grid.push_back(5);
+            std::lock_guard<std::mutex> guard(detail::stats_state().rows);
+            fit_sidecar(sidecar, grid);
+            std::vector<hsize_t> extent = sidecar.space().extent();
+            if (grid[0] > old_grid[0]) {
+                std::vector<hsize_t> start(rank + 1, 0), box(extent);
+                start[0] = old_grid[0];
+                box[0] = grid[0] - old_grid[0];
+                const double empty[5] = { INFINITY, -INFINITY, 0, 0, 0 };
+                std::vector<double> rows;
+                for (hsize_t c = util::product(box.begin(), box.end() - 1, hsize_t(1)); c > 0; --c)
+                    rows.insert(rows.end(), empty, empty + 5);
+                if (!rows.empty())
+                    sidecar.write(rows.data(), DType::DOUBLE, DSpace(box), Hyperslab(start, box));
+            }
+            for (size_t d = 0; cut && d < rank; ++d) {
+                if (before[d] == after[d] || (d == 0 && before[d] < after[d]))
+                    continue;
+                std::vector<hsize_t> start(rank + 1, 0), box(extent);
+                start[d] = std::min(before[d], after[d]) / chunk[d];
+                box[d] -= start[d];
+                std::vector<double> unknown(size_t(util::product(box.begin(), box.end(), hsize_t(1))), NAN);
+                if (!unknown.empty())
+                    sidecar.write(unknown.data(), DType::DOUBLE, DSpace(box), Hyperslab(start, box));
+            }
         }
-        //write
-        void write(const void* buffer, const DType& buffer_type, const DSpace& buffer_shape, const Selection& selection = Selection::ALL) {
-            check(H5Dwrite(id, buffer_type, buffer_shape, space().select(selection), H5P_DATASET_XFER_DEFAULT, buffer));
-        }
-        void write(const void* buffer, const DType& buffer_type, const DSpace& buffer_shape, const std::vector<hsize_t>& offset) {
-            //we need to pad buffer_shape and offset to the correct dimensionality for making the selection
-            //get the current extent of the dataset:
+        //select buffer_extent at offset: both are padded to the dataset's rank, with 1s and 0s
+        Hyperslab offset_selection(std::vector<hsize_t> buffer_extent, std::vector<hsize_t> offset) {
             auto extent = space().extent();
-            //get the extent of the buffer and prepend with 1's:
-            auto buffer_extent = buffer_shape.extent();
             if (buffer_extent.size() < extent.size())
                 util::prepend(buffer_extent, extent.size() - buffer_extent.size(), hsize_t(1));
-            //prepend the offset with 0s:
-            std::vector<hsize_t> new_offset(offset);
-            if (new_offset.size() < extent.size())
-                util::prepend(new_offset, extent.size() - new_offset.size(), hsize_t(0));
-            write(buffer, buffer_type, buffer_shape, Hyperslab(new_offset, buffer_extent));
+            if (offset.size() < extent.size())
+                util::prepend(offset, extent.size() - offset.size(), hsize_t(0));
+            return Hyperslab(offset, buffer_extent);
+        }
+        //HDF5 moves data far more slowly between spaces of different ranks, like a vector's 1D space and a block of a 2D
+        //dataset. If memory is all of a space of another rank, and the file selection is one block holding as many
+        //items, return memory with the block's shape
+        static std::unique_ptr<DSpace> block_shaped(const DSpace& memory, const DSpace& file) {
+            int rank = H5Sget_simple_extent_ndims(file);
+            if (rank <= 0 || rank == H5Sget_simple_extent_ndims(memory) || H5Sget_select_type(memory) != H5S_SEL_ALL)
+                return nullptr;
+            hssize_t n = H5Sget_select_npoints(file);
+            if (n <= 0 || n != H5Sget_select_npoints(memory))
+                return nullptr;
+            std::vector<hsize_t> start(rank), end(rank);
+            check(H5Sget_select_bounds(file, start.data(), end.data()));
+            for (int d = 0; d < rank; ++d)
+                end[d] = end[d] - start[d] + 1;
+            if (util::product(end.begin(), end.end(), hsize_t(1)) != hsize_t(n))
+                return nullptr;
+            return std::unique_ptr<DSpace>(new DSpace(end));
+        }
+        //write buffer, laid out as H5TL::memory_space() says: in place, or gathered into a copy if HDF5 can't select it
+        template<typename data_t>
+        void write_buffer(const data_t& buffer, const DType& buffer_type, const Selection& selection) {
+            detail::strided_layout l = detail::memory_layout(buffer);
+            if (!l.staged) {
+                write(H5TL::data(buffer), buffer_type, l.space, selection);
+                return;
+            }
+            size_t sz = buffer_type.size();
+            aligned_vector<char> packed(size_t(l.space.count()) * sz);
+            detail::stage(l, sz, (const char*)H5TL::data(buffer), packed.data(), false);
+            write(packed.data(), buffer_type, l.space, selection);
+        }
+        //read into buffer, laid out as H5TL::memory_space() says: in place, or scattered from a copy
+        template<typename data_t>
+        void read_buffer(data_t& buffer, const Selection& selection) {
+            detail::strided_layout l = detail::memory_layout(buffer);
+            if (!l.staged) {
+                read(H5TL::data(buffer), H5TL::dtype(buffer), l.space, selection);
+                return;
+            }
+            size_t sz = H5TL::dtype(buffer).size();
+            aligned_vector<char> packed(size_t(l.space.count()) * sz);
+            read(packed.data(), H5TL::dtype(buffer), l.space, selection);
+            detail::stage(l, sz, packed.data(), (char*)H5TL::data(buffer), true);
+        }
+        //extend the dataset, if need be, to hold buffer_extent at offset
+        void grow(std::vector<hsize_t> buffer_extent, const std::vector<hsize_t>& offset) {
+            //get the current and maximum extents of the dataset
+            std::vector<hsize_t> current_extent, max_extent;
+            std::tie(current_extent, max_extent) = space().extents();
+            //prepend 1s to the buffer extent as necessary to make it the correct size
+            if (buffer_extent.size() < current_extent.size()) {
+                util::prepend(buffer_extent, current_extent.size() - buffer_extent.size(), hsize_t(1));
+            }
+            //the new extents will be the offset + buffer_extent
+            std::vector<hsize_t> new_extent(offset.size());
+            std::transform(buffer_extent.begin(), buffer_extent.end(), offset.begin(), new_extent.begin(), std::plus<hsize_t>());
+            //if any element of the new extents are > current extents, we need to extend the dataset
+            if (!std::equal(new_extent.begin(), new_extent.end(), current_extent.begin(), std::less_equal<hsize_t>())) {
+                //only grow -- keep the current extent in dimensions the buffer doesn't reach
+                std::transform(new_extent.begin(), new_extent.end(), current_extent.begin(), new_extent.begin(), [](hsize_t a, hsize_t b) { return std::max(a, b); });
+                resize(new_extent);
+            }
+        }
+        //extend the slowest varying dimension (0) by the rows of buffer_extent, and return the offset of the new rows
+        std::vector<hsize_t> grow(std::vector<hsize_t> buffer_extent) {
+            //get the current extent
+            std::vector<hsize_t> current_extent = space().extent();
+            //get the buffer shape, and extend as necessary
+            if (buffer_extent.size() < current_extent.size()) {
+                util::prepend(buffer_extent, current_extent.size() - buffer_extent.size(), hsize_t(1));
+            }
+            //we only extend the slowest varying dimension for now
+            //TODO: extend the fastest varying extendable dimension?
+            size_t dim_to_extend = 0;
+            //compute the offset into the file where we will store the data
+            std::vector<hsize_t> offset(current_extent.size(), 0);
+            offset[dim_to_extend] = current_extent[dim_to_extend];
+            current_extent[dim_to_extend] += buffer_extent[dim_to_extend];
+            //extend -- this only sets the extent and writes into the new rows, so it is safe while SWMR writing
+            resize(current_extent);
+            return offset;
+        }
+    public:
+        Dataset() : Object(), xfer(hid_t(H5P_DEFAULT)) {}
+        //copy shares the dataset, and its transfer properties
+        Dataset(const Dataset &dset) : Object(dset), xfer(share_xfer(dset.xfer)), stats(std::atomic_load(&dset.stats)) {}
+        Dataset& operator=(const Dataset& dset) {
+            Dataset tmp(dset);
+            steal(tmp);
+            xfer = std::move(tmp.xfer);
+            stats = std::move(tmp.stats);
+            return *this;
+        }
+        //move
+        Dataset(Dataset &&dset) noexcept : Object(std::move(dset)), xfer(std::move(dset.xfer)), stats(std::move(dset.stats)) {}
+        Dataset& operator=(Dataset&& dset) {
+            steal(dset);
+            xfer = std::move(dset.xfer);
+            stats = std::move(dset.stats);
+            return *this;
+        }
+        ~Dataset() {
+            if (id) close();
+        }
+        void close() {
+            check(H5TL_PROFILED_CLOSE("H5Dclose", id, H5Dclose(id))); id = 0;
+        }
+        DSpace space() {
+            return DSpace(H5TL_PROFILED("H5Dget_space", id, 0, H5Dget_space(id)));
+        }
+        DType dtype() {
+            return DType(H5TL_PROFILED("H5Dget_type", id, 0, H5Dget_type(id)));
+        }
+        DProps props() {
+            return DProps(H5TL_PROFILED("H5Dget_create_plist", id, 0, H5Dget_create_plist(id)));
+        }
+        /** \brief Throw an h5tl_error naming any filter the dataset uses that the library can't load.
+        *
+        * Reads check this when they fail; call it to find out before reading.
+        */
+        void require_filters() {
+            props().require_filters();
+        }
+        /** \brief Set the transfer properties for reads and writes through this handle, eg. XProps().collective()
+        *
+        * Copies of this handle made afterwards share them; other handles to the dataset keep their own.
+        */
+        Dataset& transfer(const XProps& xprops) {
+            xfer = xprops.share();
+            return *this;
+        }
+        //write
+        void write(const void* buffer, const DType& buffer_type, const DSpace& buffer_shape, const Selection& selection = Selection::ALL) {
+            DSpace file_space = space();
+            file_space.select(selection);
+            std::unique_ptr<DSpace> block = block_shaped(buffer_shape, file_space);
+            const DSpace& memory = block ? *block : buffer_shape;
+            check(H5TL_PROFILED(profile::converts(H5Dget_type(id), buffer_type) ? "H5Dwrite (convert)" : "H5Dwrite",
+                id, profile::nbytes(buffer_shape, buffer_type), H5Dwrite(id, buffer_type, memory, file_space, xfer, buffer)));
+            if (std::shared_ptr<Dataset> sidecar = stats_sidecar())
+                update_stats(*sidecar, buffer, buffer_type, memory, file_space);
+        }
+        void write(const void* buffer, const DType& buffer_type, const DSpace& buffer_shape, const std::vector<hsize_t>& offset) {
+            H5TL_PROFILE_SCOPE("Dataset::write", id);
+            write(buffer, buffer_type, buffer_shape, offset_selection(buffer_shape.extent(), offset));
         }
         template<typename data_t>
         void write(const data_t& buffer, const DSpace& buffer_shape, const Selection& selection = Selection::ALL) {
-            write(H5TL::data(buffer), H5TL::dtype(buffer), buffer_shape);
+            write(H5TL::data(buffer), H5TL::dtype(buffer), buffer_shape, selection);
         }
         template<typename data_t>
         void write(const data_t& buffer, const DSpace& buffer_shape, const std::vector<hsize_t>& offset) {
             write(H5TL::data(buffer), H5TL::dtype(buffer), buffer_shape, offset);
         }
+        //these take the buffer's layout from H5TL::memory_space(), so strided data is written without copying it first
         template<typename data_t>
         void write(const data_t& buffer, const DType& buffer_type, const Selection& selection = Selection::ALL) {
-            write(H5TL::data(buffer), buffer_type, H5TL::space(buffer), selection);
+            write_buffer(buffer, buffer_type, selection);
         }
         template<typename data_t>
         void write(const data_t& buffer, const DType& buffer_type, const std::vector<hsize_t>& offset) {
-            write(H5TL::data(buffer), buffer_type, H5TL::space(buffer), offset);
+            H5TL_PROFILE_SCOPE("Dataset::write", id);
+            write_buffer(buffer, buffer_type, offset_selection(H5TL::shape(buffer), offset));
         }
         template<typename data_t>
         void write(const data_t& buffer, const Selection& selection = Selection::ALL) {
-            write(H5TL::data(buffer), H5TL::dtype(buffer), H5TL::space(buffer));
+            write_buffer(buffer, H5TL::dtype(buffer), selection);
         }
         template<typename data_t>
         void write(const data_t& buffer, const std::vector<hsize_t>& offset) {
-            write(H5TL::data(buffer), H5TL::dtype(buffer), H5TL::space(buffer), offset);
+            write(buffer, H5TL::dtype(buffer), offset);
+        }
+        //resize -- sets the extent, which may shrink as well as grow each dimension
+        void resize(const std::vector<hsize_t>& extent) {
+            std::shared_ptr<Dataset> sidecar = stats_sidecar();
+            std::vector<hsize_t> before = sidecar ? space().extent() : std::vector<hsize_t>();
+            check(H5TL_PROFILED("H5Dset_extent", id, 0, H5Dset_extent(id, extent.data())));
+            if (sidecar)
+                forget_stats(*sidecar, before, extent);
         }
-        //extend
+        //extend -- grows each dimension to at least extent, never shrinking any
         void extend(const hsize_t* extent) {
-            check(H5Dextend(id, extent));
+            H5TL_PROFILE_SCOPE("Dataset::extend", id);
+            std::vector<hsize_t> current_extent = space().extent();
+            for (size_t i = 0; i < current_extent.size(); ++i)
+                current_extent[i] = std::max(current_extent[i], extent[i]);
+            resize(current_extent);
         }
         void extend(const std::vector<hsize_t>& extent) {
             extend(extent.data());
         }
+        /** \brief Reload the dataset's metadata, to see changes made by a SWMR writer.
+        */
+        void refresh() {
+            check(H5TL_PROFILED("H5Drefresh", id, 0, H5Drefresh(id)));
+        }
+        /** \brief Flush the dataset's data and metadata, making them visible to SWMR readers.
+        */
+        void flush() {
+            check(H5TL_PROFILED("H5Dflush", id, 0, H5Dflush(id)));
+        }
         //append with offset -- like write with offset, but checks to see if the dataset needs to be extended first
         
         void append(const void* buffer, const DType& buffer_type, const DSpace& buffer_shape, const std::vector<hsize_t>& offset) {
-            //get the current and maximum extents of the dataset
-            std::vector<hsize_t> current_extent, max_extent;
-            std::tie(current_extent, max_extent) = space().extents();
-            //get the buffer extents, prepend 1s as necessary to make it the correct size
-            std::vector<hsize_t> buffer_extent = buffer_shape.extent();
-            if (buffer_extent.size() < current_extent.size()) {
-                util::prepend(buffer_extent, current_extent.size() - buffer_extent.size(), hsize_t(1));
-            }
-            //do we need to extend the dataset?
-            //the new extents will be the offset + buffer_extent
-            std::vector<hsize_t> new_extent(offset.size());
-            std::transform(buffer_extent.begin(), buffer_extent.end(), offset.begin(), new_extent.begin(), std::plus<hsize_t>());
-            //if any element of the new extents are > current extents, we need to extend the dataset
-            if (!std::equal(new_extent.begin(), new_extent.end(), current_extent.begin(), std::less_equal<hsize_t>())) {
-                extend(new_extent);
-            }
+            H5TL_PROFILE_SCOPE("Dataset::append", id);
+            grow(buffer_shape.extent(), offset);
             //now that the dataset is extended, we can write into it
             write(buffer, buffer_type, buffer_shape, offset);
         }
@@ -1021,33 +3241,20 @@ namespace H5TL {
         }
         template<typename data_t>
         void append(const data_t& buffer, const DType& buffer_type, const std::vector<hsize_t>& offset) {
-            append(H5TL::data(buffer), buffer_type, H5TL::space(buffer), offset);
+            H5TL_PROFILE_SCOPE("Dataset::append", id);
+            grow(H5TL::shape(buffer), offset);
+            write(buffer, buffer_type, offset);
         }
         template<typename data_t>
         void append(const data_t& buffer, const std::vector<hsize_t>& offset) {
-            append(H5TL::data(buffer), H5TL::dtype(buffer), H5TL::space(buffer), offset);
+            append(buffer, H5TL::dtype(buffer), offset);
         }
         
         //append without offset -- automatically extends the slowest varying dimension (0)
         void append(const void *buffer, const DType& buffer_type, const DSpace& buffer_shape) {
-            //get the current extent
-            std::vector<hsize_t> current_extent = space().extent();
-            //get the buffer shape, and extend as necessary
-            std::vector<hsize_t> buffer_extent = buffer_shape.extent();
-            if (buffer_extent.size() < current_extent.size()) {
-                util::prepend(buffer_extent, current_extent.size() - buffer_extent.size(), hsize_t(1));
-            }
-            //we only extend the slowest varying dimension for now
-            //TODO: extend the fastest varying extendable dimension?
-            size_t dim_to_extend = 0;
-            //compute the offset into the file where we will store the data
-            std::vector<hsize_t> offset(current_extent.size(), 0);
-            offset[dim_to_extend] = current_extent[dim_to_extend];
-            current_extent[dim_to_extend] += buffer_extent[dim_to_extend];
-            //extend
-            extend(current_extent);
-            //write
-            write(buffer, buffer_type, DSpace(buffer_extent), offset);
+            H5TL_PROFILE_SCOPE("Dataset::append", id);
+            std::vector<hsize_t> offset = grow(buffer_shape.extent());
+            write(buffer, buffer_type, buffer_shape, offset);
         }
 
         template<typename data_t>
@@ -1056,18 +3263,76 @@ namespace H5TL {
         }
         template<typename data_t>
         void append(const data_t& buffer, const DType& buffer_type) {
-            append(H5TL::data(buffer), buffer_type, H5TL::space(buffer));
+            H5TL_PROFILE_SCOPE("Dataset::append", id);
+            std::vector<hsize_t> offset = grow(H5TL::shape(buffer));
+            write(buffer, buffer_type, offset);
         }
         template<typename data_t>
         void append(const data_t& buffer) {
-            append(H5TL::data(buffer), H5TL::dtype(buffer), H5TL::space(buffer));
+            append(buffer, H5TL::dtype(buffer));
+        }
+#ifdef H5TL_PARALLEL
+        /** \brief Append rows from every rank of comm at once, with one collective write.
+        *
+        * Every rank must call this. The ranks' rows are stored in rank order after the rows already in the dataset: the
+        * ranks sum their row counts so that each extends the dataset to the same extent, then each writes its rows after
+        * those of the ranks before it. A rank may append no rows.
+        */
+        void append(MPI_Comm comm, const void *buffer, const DType& buffer_type, const DSpace& buffer_shape) {
+            H5TL_PROFILE_SCOPE("Dataset::append (collective)", id);
+            std::vector<hsize_t> current_extent = space().extent();
+            if (current_extent.empty())
+                throw std::runtime_error("Cannot append to a scalar dataset.");
+            std::vector<hsize_t> buffer_extent = buffer_shape.extent();
+            if (buffer_extent.size() < current_extent.size()) {
+                util::prepend(buffer_extent, current_extent.size() - buffer_extent.size(), hsize_t(1));
+            }
+            hsize_t before, total;
+            parallel::count(comm, buffer_extent[0], before, total);
+            std::vector<hsize_t> offset(current_extent.size(), 0);
+            offset[0] = current_extent[0] + before;
+            current_extent[0] += total;
+            resize(current_extent);
+            //ranks without rows still take part in the collective write, selecting nothing
+            DSpace memory_space(buffer_extent), file_space = space();
+            if (buffer_extent[0] > 0) {
+                file_space.select(Hyperslab(offset, buffer_extent));
+            }
+            else {
+                check(H5Sselect_none(memory_space));
+                check(H5Sselect_none(file_space));
+            }
+            XProps collective;
+            collective.collective();
+            check(H5TL_PROFILED("H5Dwrite", id, profile::nbytes(memory_space, buffer_type),
+                H5Dwrite(id, buffer_type, memory_space, file_space, collective, buffer)));
+        }
+        template<typename data_t>
+        void append(MPI_Comm comm, const data_t& buffer, const DSpace& buffer_shape) {
+            append(comm, H5TL::data(buffer), H5TL::dtype(buffer), buffer_shape);
+        }
+        template<typename data_t>
+        void append(MPI_Comm comm, const data_t& buffer) {
+            append(comm, H5TL::data(buffer), H5TL::dtype(buffer), H5TL::space(buffer));
         }
+#endif
         //read
         void read(void* buffer, const DType& buffer_type, const DSpace& buffer_shape, const Selection& selection = Selection::ALL) {
             //if buffer_shape is empty, allocate space to hold the selection???
-            check(H5Dread(id, buffer_type, buffer_shape, space().select(selection), H5P_DATASET_XFER_DEFAULT, buffer));
+            DSpace file_space = space();
+            file_space.select(selection);
+            std::unique_ptr<DSpace> block = block_shaped(buffer_shape, file_space);
+            const DSpace& memory = block ? *block : buffer_shape;
+            if (H5TL_PROFILED(profile::converts(H5Dget_type(id), buffer_type) ? "H5Dread (convert)" : "H5Dread",
+                id, profile::nbytes(buffer_shape, buffer_type), H5Dread(id, buffer_type, memory, file_space, xfer, buffer)) < 0) {
+                //take the error before the next call clears it, then report a missing filter by name if that was the cause
+                h5tl_error e = ErrorHandler::EH.current_error();
+                require_filters();
+                throw e;
+            }
         }
         void read(void* buffer, const DType& buffer_type, const DSpace& buffer_shape, const std::vector<hsize_t>& offset) {
+            H5TL_PROFILE_SCOPE("Dataset::read", id);
             read(buffer, buffer_type, buffer_shape, Hyperslab(offset, buffer_shape.extent()));
         }
         //read w/ reference to a container
@@ -1079,13 +3344,15 @@ namespace H5TL {
         void read(data_t& buffer, const DSpace& buffer_shape, const std::vector<hsize_t>& offset) {
             read(H5TL::data(buffer), H5TL::dtype(buffer), buffer_shape, offset);
         }
+        //these take the buffer's layout from H5TL::memory_space(), so strided data is read without copying it after
         template<typename data_t>
         void read(data_t& buffer, const Selection& selection = Selection::ALL) {
-            read(H5TL::data(buffer), H5TL::dtype(buffer), H5TL::space(buffer), selection);
+            read_buffer(buffer, selection);
         }
         template<typename data_t>
         void read(data_t& buffer, const std::vector<hsize_t>& offset) {
-            read(H5TL::data(buffer), H5TL::dtype(buffer), H5TL::space(buffer), offset);
+            H5TL_PROFILE_SCOPE("Dataset::read", id);
+            read_buffer(buffer, Hyperslab(offset, H5TL::shape(buffer)));
         }
         //read w/ pointer to buffer
         template<typename data_t>
@@ -1109,7 +3376,7 @@ namespace H5TL {
         typename adapt<data_t>::allocate_return
 			read(const std::vector<hsize_t>& buffer_shape, const std::vector<hsize_t>& offset) {
                 auto buffer = H5TL::allocate<data_t>(buffer_shape, dtype());
-                read(buffer, DSpace(buffer_shape), offset);
+                read_buffer(buffer, offset_selection(buffer_shape, offset));
                 return buffer;
         }
         template<typename data_t>
@@ -1119,93 +3386,568 @@ namespace H5TL {
                 read(buffer);
                 return buffer;
         }
+        /** \brief Read the rows added since the last call, for following a dataset being appended to.
+        *
+        * Refreshes the dataset, then reads the rows of the slowest varying dimension from position up to the current
+        * extent, and advances position past them. Start position at 0 to read everything.
+        * \param[in,out] position The first row not yet read.
+        * \returns The new rows, which may be empty.
+        */
+        template<typename data_t>
+        typename adapt<data_t>::allocate_return
+            tail(hsize_t& position) {
+                H5TL_PROFILE_SCOPE("Dataset::tail", id);
+                refresh();
+                std::vector<hsize_t> shape = space().extent();
+                if (shape.empty())
+                    throw std::runtime_error("Cannot tail a scalar dataset.");
+                std::vector<hsize_t> offset(shape.size(), 0);
+                offset[0] = std::min(position, shape[0]);
+                shape[0] -= offset[0];
+                auto buffer = H5TL::allocate<data_t>(shape, dtype());
+                if (shape[0] > 0)
+                    read_buffer(buffer, Hyperslab(offset, shape));
+                position = offset[0] + shape[0];
+                return buffer;
+        }
+        /** \brief Keep the ChunkStats of each chunk, so query() can skip the chunks that can't match.
+        *
+        * The stats are stored in the dataset <name>_stats, of doubles shaped like the grid of chunks with one more
+        * dimension of 5: min, max, sum, count and nan_count. The dataset's H5TL_stats attribute refers to it. They are
+        * computed now, then kept up to date by writes, appends and resizes through this handle and any opened
+        * afterwards. Other writers -- other handles already open, collective appends, other libraries -- leave the
+        * chunks they write summarized as before: call this again to recompute every chunk.
+        *
+        * Growing dimension 0 leaves the new rows uncounted, and a write that starts just after a chunk's counted rows
+        * and spans the rest of the chunk is folded into its stats, so appends read nothing back. Other writes re-read
+        * the chunks they touch. The file's root group gets an H5TL_stats attribute too, so handles in files without
+        * tracked stats don't look for them.
+        */
+        Dataset& track_stats() {
+            H5TL_PROFILE_SCOPE("Dataset::track_stats", id);
+            H5T_class_t type_class = H5Tget_class(dtype());
+            if (type_class != H5T_INTEGER && type_class != H5T_FLOAT)
+                throw std::runtime_error("Cannot track the stats of a dataset that isn't integers or floats.");
+            std::vector<hsize_t> extent = space().extent();
+            if (props().chunk().empty() || extent.empty())
+                throw std::runtime_error("Cannot track the stats of an unchunked dataset.");
+            std::shared_ptr<Dataset> sidecar = stats_sidecar();
+            if (!sidecar) {
+                ssize_t n = H5TL_PROFILED("H5Iget_name", id, 0, H5Iget_name(id, nullptr, 0));
+                if (n <= 0)
+                    throw std::runtime_error("Cannot track the stats of an anonymous dataset.");
+                std::string name(size_t(n) + 1, '\0');
+                H5TL_PROFILED("H5Iget_name", id, 0, H5Iget_name(id, &name[0], name.size()));
+                name.resize(size_t(n));
+                name += "_stats";
+                std::vector<hsize_t> grid = chunk_grid(extent, chunk_or_extent(extent)), max_grid(grid.size() + 1, H5S_UNLIMITED);
+                std::vector<hsize_t> expected(grid);
+                for (hsize_t& g : expected)
+                    g = std::max<hsize_t>(g, 1024);
+                grid.push_back(5); max_grid.back() = 5; expected.push_back(5);
+                DProps sprops;
+                sprops.chunked(ChunkPlanner(expected, sizeof(double))).fill(double(NAN));
+                Dataset s(H5TL_PROFILED("H5Dcreate", id, 0,
+                    H5Dcreate(id, name.c_str(), DType::DOUBLE, DSpace(grid, max_grid), LProps::DEFAULT, sprops, H5P_DATASET_ACCESS_DEFAULT)));
+                s.stats = std::make_shared<Dataset>();
+                hobj_ref_t ref;
+                check(H5TL_PROFILED("H5Rcreate", id, 0, H5Rcreate(&ref, id, name.c_str(), H5R_OBJECT, -1)));
+                writeAttribute("H5TL_stats", &ref, DType::REFERENCE, DSpace());
+                if (!check_tri(H5TL_PROFILED("H5Aexists_by_name", id, 0, H5Aexists_by_name(id, "/", "H5TL_stats", H5P_DEFAULT)))) {
+                    hid_t tag = check_id(H5TL_PROFILED("H5Acreate_by_name", id, 0,
+                        H5Acreate_by_name(id, "/", "H5TL_stats", DType::UINT8, DSpace(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)));
+                    check(H5Aclose(tag));
+                }
+                {
+                    detail::stats_registry& r = detail::stats_state();
+                    std::lock_guard<std::mutex> guard(r.mutex);
+                    ++r.generation;
+                    r.files.clear();
+                }
+                sidecar = std::make_shared<Dataset>(std::move(s));
+                std::atomic_store(&stats, sidecar);
+            }
+            summarize(*sidecar, std::vector<hsize_t>(extent.size(), 0), chunk_grid(extent, chunk_or_extent(extent)));
+            return *this;
+        }
+        /** \brief The ChunkStats of every chunk, in C order of the grid of chunks.
+        *
+        * Every chunk is unknown if the stats aren't tracked. An unchunked dataset is one chunk.
+        */
+        std::vector<ChunkStats> chunk_stats() {
+            H5TL_PROFILE_SCOPE("Dataset::chunk_stats", id);
+            std::vector<hsize_t> extent = space().extent();
+            std::vector<hsize_t> grid = chunk_grid(extent, chunk_or_extent(extent));
+            const ChunkStats unknown = { NAN, NAN, NAN, 0, 0, false };
+            std::vector<ChunkStats> all(size_t(util::product(grid.begin(), grid.end(), hsize_t(1))), unknown);
+            std::shared_ptr<Dataset> sidecar = stats_sidecar();
+            if (!sidecar || all.empty())
+                return all;
+            //the sidecar may be smaller than the grid, if another writer grew the dataset
+            std::vector<hsize_t> box = sidecar->space().extent();
+            for (size_t d = 0; d < grid.size(); ++d)
+                box[d] = std::min(box[d], grid[d]);
+            if (util::product(box.begin(), box.end(), hsize_t(1)) == 0)
+                return all;
+            std::vector<double> rows(size_t(util::product(box.begin(), box.end(), hsize_t(1))));
+            sidecar->read(rows.data(), DType::DOUBLE, DSpace(box), Hyperslab(std::vector<hsize_t>(box.size(), 0), box));
+            box.pop_back();
+            std::vector<hsize_t> zero(grid.size(), 0), pos(zero);
+            const double* row = rows.data();
+            do {
+                size_t i = 0;
+                for (size_t d = 0; d < grid.size(); ++d)
+                    i = i*size_t(grid[d]) + size_t(pos[d]);
+                if (!std::isnan(row[3]))
+                    all[i] = { row[0], row[1], row[2], uint64_t(row[3]), uint64_t(row[4]), true };
+                row += 5;
+            } while (next_position(pos, zero, box));
+            return all;
+        }
+        /** \brief Find the items that match, reading only the chunks whose stats say they might.
+        *
+        * Items are compared as doubles. Without tracked stats every chunk is read.
+        * \param match A Predicate, or anything with the same operator() and may_match().
+        * \returns The index of each matching item in the flattened (C order) dataset, in ascending order.
+        */
+        template<typename predicate_t>
+        std::vector<hsize_t> query(const predicate_t& match) {
+            H5TL_PROFILE_SCOPE("Dataset::query", id);
+            std::vector<hsize_t> extent = space().extent();
+            if (extent.empty())
+                throw std::runtime_error("Cannot query a scalar dataset.");
+            const size_t rank = extent.size();
+            std::vector<hsize_t> chunk = chunk_or_extent(extent), grid = chunk_grid(extent, chunk);
+            std::vector<ChunkStats> all = chunk_stats();
+            std::vector<hsize_t> found, zero(rank, 0), pos(zero), origin(rank), shape(rank);
+            std::vector<double> values;
+            for (const ChunkStats& s : all) {
+                for (size_t d = 0; d < rank; ++d) {
+                    origin[d] = pos[d] * chunk[d];
+                    shape[d] = std::min(chunk[d], extent[d] - origin[d]);
+                }
+                hsize_t items = util::product(shape.begin(), shape.end(), hsize_t(1));
+                //items the stats don't count hold fill values, which may match
+                if (!s.known || s.count < items || match.may_match(s)) {
+                    values.resize(size_t(items));
+                    read(values.data(), DType::DOUBLE, DSpace(shape), Hyperslab(origin, shape));
+                    //a row of the last dimension at a time, as its items are consecutive in the dataset too
+                    std::vector<hsize_t> item(zero), rows(shape);
+                    rows.back() = 1;
+                    const double* v = values.data();
+                    do {
+                        hsize_t i = 0;
+                        for (size_t d = 0; d < rank; ++d)
+                            i = i*extent[d] + origin[d] + item[d];
+                        for (hsize_t k = 0; k < shape.back(); ++k, ++v)
+                            if (match(*v)) found.push_back(i + k);
+                    } while (next_position(item, zero, rows));
+                }
+                next_position(pos, zero, grid);
+            }
+            if (rank > 1)
+                std::sort(found.begin(), found.end());
+            return found;
+        }
+    };
+
+    /** \brief Collects small writes to a chunked dataset, and writes each chunk once all of it has been written.
+    *
+    * Writes are copied into a buffer for each chunk they touch. A chunk goes to the dataset -- and through its filters --
+    * once, when every item in it has been written. flush() writes the rest, first reading back the items that were not
+    * written so they are kept. The destructor flushes too, ignoring errors: call flush() to see them. Writes must lie
+    * within the dataset's extent as it was when the combiner was made, and a later write to an item replaces an earlier one.
+    */
+    class WriteCombiner {
+    protected:
+        struct chunk_buffer {
+            std::vector<char> data;
+            std::vector<bool> covered;
+            size_t ncovered;
+        };
+        Dataset dset;
+        DType type;
+        size_t item_nbytes;
+        std::vector<hsize_t> extent, chunk;
+        std::map<std::vector<hsize_t>, chunk_buffer> buffers; //by the origin of each chunk
+
+        //the shape of the chunk at origin, clipped to the extent
+        std::vector<hsize_t> chunk_shape(const std::vector<hsize_t>& origin) const {
+            std::vector<hsize_t> shape(chunk);
+            for (size_t d = 0; d < shape.size(); ++d)
+                shape[d] = std::min(shape[d], extent[d] - origin[d]);
+            return shape;
+        }
+        void write_chunk(const std::vector<hsize_t>& origin, chunk_buffer& b) {
+            std::vector<hsize_t> shape = chunk_shape(origin);
+            if (b.ncovered < b.covered.size()) {
+                //partly written: keep what the dataset has for the rest
+                std::vector<char> current(b.data.size());
+                dset.read(current.data(), type, DSpace(shape), Hyperslab(origin, shape));
+                for (size_t i = 0; i < b.covered.size(); ++i)
+                    if (!b.covered[i]) std::memcpy(&b.data[i*item_nbytes], &current[i*item_nbytes], item_nbytes);
+            }
+            dset.write(b.data.data(), type, DSpace(shape), Hyperslab(origin, shape));
+        }
+        //copy the part of a write at start that falls in the chunk at origin, writing the chunk if that completes it
+        void combine(const std::vector<hsize_t>& origin, const char* buffer, const std::vector<hsize_t>& shape, const std::vector<hsize_t>& start) {
+            const size_t rank = origin.size();
+            std::vector<hsize_t> cshape = chunk_shape(origin);
+            auto it = buffers.find(origin);
+            if (it == buffers.end()) {
+                size_t n = util::product(cshape.begin(), cshape.end(), size_t(1));
+                chunk_buffer b = { std::vector<char>(n*item_nbytes), std::vector<bool>(n, false), 0 };
+                it = buffers.insert(std::make_pair(origin, std::move(b))).first;
+            }
+            chunk_buffer& b = it->second;
+            //the box covered by both, in dataset coordinates
+            std::vector<hsize_t> lo(rank), hi(rank);
+            for (size_t d = 0; d < rank; ++d) {
+                lo[d] = std::max(start[d], origin[d]);
+                hi[d] = std::min(start[d] + shape[d], origin[d] + cshape[d]);
+            }
+            //copy it a row of the last dimension at a time
+            const size_t row = size_t(hi[rank - 1] - lo[rank - 1]);
+            std::vector<hsize_t> pos(lo);
+            for (;;) {
+                size_t src = 0, dst = 0;
+                for (size_t d = 0; d < rank; ++d) {
+                    src = src*size_t(shape[d]) + size_t(pos[d] - start[d]);
+                    dst = dst*size_t(cshape[d]) + size_t(pos[d] - origin[d]);
+                }
+                std::memcpy(&b.data[dst*item_nbytes], buffer + src*item_nbytes, row*item_nbytes);
+                for (size_t k = dst; k < dst + row; ++k) {
+                    if (!b.covered[k]) {
+                        b.covered[k] = true;
+                        ++b.ncovered;
+                    }
+                }
+                size_t d = rank - 1;
+                while (d > 0 && pos[d - 1] + 1 == hi[d - 1]) {
+                    pos[d - 1] = lo[d - 1];
+                    --d;
+                }
+                if (d == 0) break;
+                ++pos[d - 1];
+            }
+            if (b.ncovered == b.covered.size()) {
+                write_chunk(origin, b);
+                buffers.erase(it);
+            }
+        }
+    public:
+        ///Combine writes of mem_type items to dset, which must be chunked
+        WriteCombiner(const Dataset& dset, const DType& mem_type) : dset(dset), type(mem_type), item_nbytes(mem_type.size()) {
+            extent = this->dset.space().extent();
+            chunk = this->dset.props().chunk();
+            if (chunk.empty())
+                throw std::runtime_error("WriteCombiner needs a chunked dataset.");
+        }
+        WriteCombiner(const WriteCombiner&) = delete;
+        WriteCombiner& operator=(const WriteCombiner&) = delete;
+        ~WriteCombiner() {
+            try {
+                flush();
+            }
+            catch (...) {}
+        }
+        ///Write a block of buffer_shape items at offset. Missing leading dimensions are taken as 1 (0 for offset).
+        void write(const void* buffer, const std::vector<hsize_t>& buffer_shape, const std::vector<hsize_t>& offset) {
+            const size_t rank = extent.size();
+            std::vector<hsize_t> shape(buffer_shape), start(offset);
+            if (shape.size() < rank)
+                util::prepend(shape, rank - shape.size(), hsize_t(1));
+            if (start.size() < rank)
+                util::prepend(start, rank - start.size(), hsize_t(0));
+            if (shape.size() != rank || start.size() != rank)
+                throw std::runtime_error("write has more dimensions than the dataset.");
+            for (size_t d = 0; d < rank; ++d) {
+                if (shape[d] == 0) return;
+                if (start[d] + shape[d] > extent[d])
+                    throw std::runtime_error("write is outside the dataset's extent.");
+            }
+            //visit each chunk the write overlaps, last dimension fastest
+            std::vector<hsize_t> first(rank), last(rank), index(rank), origin(rank);
+            for (size_t d = 0; d < rank; ++d) {
+                first[d] = start[d] / chunk[d];
+                last[d] = (start[d] + shape[d] - 1) / chunk[d];
+            }
+            index = first;
+            for (;;) {
+                for (size_t d = 0; d < rank; ++d)
+                    origin[d] = index[d] * chunk[d];
+                combine(origin, (const char*)buffer, shape, start);
+                size_t d = rank;
+                while (d > 0 && index[d - 1] == last[d - 1]) {
+                    index[d - 1] = first[d - 1];
+                    --d;
+                }
+                if (d == 0) break;
+                ++index[d - 1];
+            }
+        }
+        template<typename data_t>
+        void write(const data_t& buffer, const std::vector<hsize_t>& offset) {
+            if (!(H5TL::dtype(buffer) == type))
+                throw std::runtime_error("buffer type does not match the WriteCombiner's type.");
+            //the chunk buffers are in C order, so strided memory is copied into C order first
+            detail::strided_layout l = detail::memory_layout(buffer);
+            if (!detail::in_c_order(l)) {
+                std::vector<char> packed(size_t(util::product(l.shape.begin(), l.shape.end(), hsize_t(1))) * item_nbytes);
+                detail::stage(l, item_nbytes, (const char*)H5TL::data(buffer), packed.data(), false);
+                write(packed.data(), l.shape, offset);
+                return;
+            }
+            write(H5TL::data(buffer), H5TL::shape(buffer), offset);
+        }
+        ///Write every buffered chunk, complete or not
+        void flush() {
+            while (!buffers.empty()) {
+                auto it = buffers.begin();
+                write_chunk(it->first, it->second);
+                buffers.erase(it);
+            }
+        }
+        ///Number of chunks buffered, waiting for the rest of their items
+        size_t pending() const {
+            return buffers.size();
+        }
     };
 
     //Files, Groups
-    class Group : public Object {
+    /** \brief Builds a virtual dataset, which reads from regions of datasets in other files without copying them.
+    *
+    * Map each source dataset onto a region of the virtual dataset, then create it with Group::createDataset(name, vds).
+    * Reads of the virtual dataset open the sources as needed, with the virtual dataset's access properties, so its
+    * DAProps chunk cache applies to them. Source files are named relative to the virtual dataset's file, or "." for
+    * the same file. Regions that no source covers read as the fill value.
+    */
+    class VirtualDatasetBuilder {
+        friend class Group;
     protected:
-        Group(hid_t id) : Object(id) {}
+        DType type;
+        DSpace space;
+        DProps props;
     public:
-        Group() : Object() {}
-        //no copy!
-        //move:
-        Group(Group &&grp) : Object(std::move(grp)) {}
-        Group& operator=(Group&& grp) {
-            steal(grp);
+        /** \param type The type of every source
+        * \param space The extent of the virtual dataset, with unlimited dimensions to grow as its sources do
+        * \param props Creation properties, eg. a fill value
+        */
+        VirtualDatasetBuilder(const DType& type, const DSpace& space, const DProps& props = DProps()) : type(type), space(space), props(props) {}
+        ///map the selected part of source_space, the space of dataset in file, onto region of the virtual dataset
+        VirtualDatasetBuilder& map(const Selection& region, const std::string& file, const std::string& dataset, const DSpace& source_space) {
+            DSpace virtual_space(space);
+            virtual_space.select(region);
+            check(H5Pset_virtual(props, virtual_space, file.c_str(), dataset.c_str(), source_space));
             return *this;
         }
-        virtual ~Group() {
-            if (id) close();
+        ///map all of dataset in file, which has shape source_shape, onto the virtual dataset at offset
+        VirtualDatasetBuilder& map(const std::vector<hsize_t>& offset, const std::string& file, const std::string& dataset, const std::vector<hsize_t>& source_shape) {
+            return map(Hyperslab(offset, source_shape), file, dataset, DSpace(source_shape));
         }
-        virtual void close() {
-            check(H5Gclose(id));
+        /** \brief Map a series of sources, each of shape block, end to end along dimension dim
+        *
+        * file or dataset name the sources printf-style: %b is replaced with 0, 1, 2... for each block in turn, and %%
+        * is a literal %. The series has no end: the virtual dataset's extent in dim, which must be unlimited, grows
+        * with the sources that exist when it is opened, see DAProps::virtual_view() and virtual_printf_gap().
+        */
+        VirtualDatasetBuilder& map_series(const std::string& file, const std::string& dataset, const std::vector<hsize_t>& block, size_t dim = 0) {
+            std::vector<hsize_t> start(block.size(), 0), count(block.size(), 1), stride(block);
+            count.at(dim) = H5S_UNLIMITED;
+            return map(Hyperslab(start, count, stride, block), file, dataset, DSpace(block));
         }
-        using ID::valid;
-        virtual bool valid(const std::string &path) {
+    };
+
+    ///how each level of a Pyramid is made from the one before: the mean or maximum of each 2x2 block, or its first sample
+    enum class Downsample { MEAN, MAX, DECIMATE };
+
+    class Group : public Object {
+    protected:
+        Group(hid_t id) : Object(id) {}
+        //check that each link along path exists, and all but the last resolve to objects
+        //returns a negative value on error, like the HDF5 htri_t functions
+        htri_t path_valid(const std::string &path) const noexcept {
             //Copy logic of H5TLpath_valid
             //the path to the current object or root is always valid:
             if (path == "." || path == "/" || path == "./")
-                return true;
+                return 1;
 
-            //make a working copy of the path
-            std::string current_path(path);
             //we want to check each step along the path, except the last
-            //so find each path delimiter in turn
+            //so find each path delimiter in turn, and check the prefix up to it
             size_t delimiter_pos = 0;
             if (path.compare(0, 1, "/") == 0)
                 delimiter_pos = 1; //skip the first '/' of an absolute path
             else if (path.compare(0, 2, "./") == 0)
                 delimiter_pos = 2; //the path starts with "./" -- skip this part
+            char step[1024];
             while ((delimiter_pos = path.find('/', delimiter_pos + 1)) != std::string::npos) {
                 //if the path ends with a '/', we should ignore it in this loop
                 if (delimiter_pos == path.size() - 1) break;
-                //change the character to null
+                //copy the prefix into a null terminated buffer, falling back to the heap for very long paths
+                std::unique_ptr<char[]> long_step;
+                char* current_path = step;
+                if (delimiter_pos >= sizeof(step)) {
+                    long_step.reset(new (std::nothrow) char[delimiter_pos + 1]);
+                    if (!long_step) return -1;
+                    current_path = long_step.get();
+                }
+                path.copy(current_path, delimiter_pos);
                 current_path[delimiter_pos] = '\0';
                 //check the link
-                if (!check_tri(H5Lexists(id, current_path.c_str(), H5P_LINK_ACCESS_DEFAULT))) return false;
+                htri_t t = H5TL_PROFILED("H5Lexists", id, 0, H5Lexists(id, current_path, H5P_LINK_ACCESS_DEFAULT));
+                if (t <= 0) return t;
                 //check that the link resolves to an object
-                if (!check_tri(H5Oexists_by_name(id, current_path.c_str(), H5P_LINK_ACCESS_DEFAULT))) return false;
-                //replace the delimiter and move on to the next step of the path
-                current_path[delimiter_pos] = '/';
+                t = H5TL_PROFILED("H5Oexists_by_name", id, 0, H5Oexists_by_name(id, current_path, H5P_LINK_ACCESS_DEFAULT));
+                if (t <= 0) return t;
             }
             //all of the steps of the path have been checked, except the last
             //make sure the link to the last object exists
-            return check_tri(H5Lexists(id, current_path.c_str(), H5P_LINK_ACCESS_DEFAULT));
+            return H5TL_PROFILED("H5Lexists", id, 0, H5Lexists(id, path.c_str(), H5P_LINK_ACCESS_DEFAULT));
         }
-        virtual bool exists(const std::string &path) {
+    public:
+        Group() : Object() {}
+        //copy shares the group
+        Group(const Group &grp) : Object(grp) {}
+        Group& operator=(const Group& grp) {
+            Group tmp(grp);
+            steal(tmp);
+            return *this;
+        }
+        //move:
+        Group(Group &&grp) noexcept : Object(std::move(grp)) {}
+        Group& operator=(Group&& grp) {
+            steal(grp);
+            return *this;
+        }
+        ~Group() {
+            if (id) close();
+        }
+        void close() {
+            //a File copied or moved into a Group holds the file's id
+            if (H5Iget_type(id) == H5I_FILE) {
+                hid_t file = id;
+                check(H5TL_PROFILED_CLOSE("H5Fclose", id, H5Fclose(id))); id = 0;
+                if (H5Iis_valid(file) <= 0)
+                    detail::forget_stats_file(file);
+                return;
+            }
+            check(H5TL_PROFILED_CLOSE("H5Gclose", id, H5Gclose(id))); id = 0;
+        }
+        using ID::valid;
+        bool valid(const std::string &path) {
+            return check_tri(path_valid(path));
+        }
+        using Object::exists;
+        bool exists(const std::string &path) {
             if (!valid(path))
                 return false;
-            return check_tri(H5Oexists_by_name(id, path.c_str(), H5P_LINK_ACCESS_DEFAULT));
+            return check_tri(H5TL_PROFILED("H5Oexists_by_name", id, 0, H5Oexists_by_name(id, path.c_str(), H5P_LINK_ACCESS_DEFAULT)));
+        }
+        /** \brief Checks whether path names an object, without throwing.
+        * \returns true if every link along path exists and resolves to an object, or the error.
+        */
+        result<bool> try_exists(const std::string &path) noexcept {
+            htri_t t = path_valid(path);
+            if (t > 0)
+                t = H5TL_PROFILED("H5Oexists_by_name", id, 0, H5Oexists_by_name(id, path.c_str(), H5P_LINK_ACCESS_DEFAULT));
+            if (t < 0)
+                return result<bool>::failure();
+            return t > 0;
         }
         bool hasAttribute(const std::string& object, const std::string& attr) {
-            return check_tri(H5Aexists_by_name(id, object.c_str(), attr.c_str(), H5P_LINK_ACCESS_DEFAULT));
+            return check_tri(H5TL_PROFILED("H5Aexists_by_name", id, 0, H5Aexists_by_name(id, object.c_str(), attr.c_str(), H5P_LINK_ACCESS_DEFAULT)));
         }
 
         Group group(const std::string &name) {
-            return Group(H5Gopen(id, name.c_str(), H5P_GROUP_ACCESS_DEFAULT));
+            return Group(H5TL_PROFILED("H5Gopen", id, 0, H5Gopen(id, name.c_str(), H5P_GROUP_ACCESS_DEFAULT)));
+        }
+        ///open a group, returning the error instead of throwing it
+        result<Group> try_group(const std::string &name) noexcept {
+            hid_t g = H5TL_PROFILED("H5Gopen", id, 0, H5Gopen(id, name.c_str(), H5P_GROUP_ACCESS_DEFAULT));
+            if (g < 0) return result<Group>::failure();
+            return Group(g);
         }
         Group createGroup(const std::string &name) {
-            return Group(H5Gcreate(id, name.c_str(), LProps::DEFAULT, H5P_GROUP_CREATE_DEFAULT, H5P_GROUP_ACCESS_DEFAULT));
+            return Group(H5TL_PROFILED("H5Gcreate", id, 0, H5Gcreate(id, name.c_str(), LProps::DEFAULT, H5P_GROUP_CREATE_DEFAULT, H5P_GROUP_ACCESS_DEFAULT)));
         }
         Dataset dataset(const std::string &name) {
-            return Dataset(H5Dopen(id, name.c_str(), H5P_DATASET_ACCESS_DEFAULT));
+            return Dataset(H5TL_PROFILED("H5Dopen", id, 0, H5Dopen(id, name.c_str(), H5P_DATASET_ACCESS_DEFAULT)));
+        }
+        ///open a dataset with access properties, eg. a larger chunk cache
+        Dataset dataset(const std::string &name, const DAProps& dapl) {
+            return Dataset(H5TL_PROFILED("H5Dopen", id, 0, H5Dopen(id, name.c_str(), dapl)));
+        }
+        ///open a dataset, returning the error instead of throwing it
+        result<Dataset> try_dataset(const std::string &name) noexcept {
+            hid_t d = H5TL_PROFILED("H5Dopen", id, 0, H5Dopen(id, name.c_str(), H5P_DATASET_ACCESS_DEFAULT));
+            if (d < 0) return result<Dataset>::failure();
+            return Dataset(d);
         }
         Dataset createDataset(const std::string &name, const DType &dt, const DSpace &space, const DProps& props = DProps::DEFAULT) {
-            //make a local copy of the dataset creation properties:
-            DProps _props(props);
-            //if space is extendable, but not chunked, we need to chunk it
-            if (!_props.is_chunked() && space.extendable())
-                _props.chunked();
+            //inspect props in place -- we only need a copy if the chunk dimensions have to be filled in
+            bool chunked = props.is_chunked();
+            int nfilters = H5Pget_nfilters(props);
+            //if space is extendable or props has filters, but not chunked, we need to chunk it
             //if props is chunked, but does not have chunk dimensions yet, we need to compute them
-            if (_props.is_chunked() && _props.chunk().size() == 0) {
-                _props.chunked(space.extent(), dt.size());
-                return Dataset(H5Dcreate(id, name.c_str(), dt, space, LProps::DEFAULT, _props, H5P_DATASET_ACCESS_DEFAULT));
+            //virtual datasets are extendable, but have no storage of their own to chunk
+            if (chunked ? props.chunk().size() == 0 : (!props.is_virtual() && (space.extendable() || nfilters > 0))) {
+                DProps _props(props);
+                //plan for the largest the dataset can get, rather than its initial extent
+                std::vector<hsize_t> expected = space.extent(), max_extent = space.max_extent();
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    if (max_extent[i] != H5S_UNLIMITED)
+                        expected[i] = max_extent[i];
+                    else //we can't know how long unlimited dimensions will get: assume some growth
+                        expected[i] = std::max<hsize_t>(expected[i], 1024);
+                }
+                _props.chunked(ChunkPlanner(expected, dt.size()).compressed(nfilters > 0));
+                return Dataset(H5TL_PROFILED("H5Dcreate", id, 0, H5Dcreate(id, name.c_str(), dt, space, LProps::DEFAULT, _props, H5P_DATASET_ACCESS_DEFAULT)));
             }
             else {
                 //no changes necessary
-                return Dataset(H5Dcreate(id, name.c_str(), dt, space, LProps::DEFAULT, _props, H5P_DATASET_ACCESS_DEFAULT));
+                return Dataset(H5TL_PROFILED("H5Dcreate", id, 0, H5Dcreate(id, name.c_str(), dt, space, LProps::DEFAULT, props, H5P_DATASET_ACCESS_DEFAULT)));
             }
         }
+#ifdef H5TL_PARALLEL
+        /** \brief Create a dataset from every rank of comm at once.
+        *
+        * Creating a dataset is collective in parallel HDF5, so every rank must call this with the same name, type and
+        * properties. The extent and maximum extent are the largest any rank asks for, so ranks needn't know each other's
+        * sizes, but they must agree on the number of dimensions.
+        */
+        Dataset createDataset(MPI_Comm comm, const std::string &name, const DType &dt, const DSpace &space, const DProps& props = DProps::DEFAULT) {
+            std::vector<hsize_t> extent, max_extent;
+            std::tie(extent, max_extent) = space.extents();
+            parallel::same(comm, (long long)extent.size(), "the number of dimensions of " + name);
+            return createDataset(name, dt, DSpace(parallel::max(comm, extent), parallel::max(comm, max_extent)), props);
+        }
+#endif
+        ///create the virtual dataset built by vds
+        Dataset createDataset(const std::string &name, const VirtualDatasetBuilder& vds) {
+            return createDataset(name, vds.type, vds.space, vds.props);
+        }
+        /** \brief Build a Pyramid of downsampled copies of the 2D dataset source, in the new group name.
+        * \param tile The chunk shape of each level is tile x tile, and the last level fits in one.
+        * \param nthreads The number of threads downsampling. Defaults to the number of hardware threads.
+        */
+        Pyramid createPyramid(const std::string &name, const std::string &source, Downsample method = Downsample::MEAN, hsize_t tile = 256, size_t nthreads = 0);
+        ///open a Pyramid made by createPyramid()
+        Pyramid pyramid(const std::string &name);
+        /** \brief Create a Table in the new group name, with a column of each name and type, and no rows.
+        * \param props The creation properties of every column, eg. its chunking and filters.
+        */
+        Table createTable(const std::string &name, const std::vector<std::pair<std::string, DType>> &columns, const DProps& props = DProps::DEFAULT);
+        ///open a Table made by createTable()
+        Table table(const std::string &name);
+        /** \brief Create a TimeSeries in the new group name: a time column of T, then a column of each value name and type.
+        * \param props The creation properties of every column.
+        * \param stride The index keeps every stride-th timestamp. Defaults to 1024, or the time column's chunk length if less.
+        */
+        template<typename T = double>
+        TimeSeries<T> createTimeSeries(const std::string &name, const std::vector<std::pair<std::string, DType>> &values, const DProps& props = DProps::DEFAULT, hsize_t stride = 0);
+        ///open a TimeSeries made by createTimeSeries<T>()
+        template<typename T = double>
+        TimeSeries<T> timeSeries(const std::string &name);
         //create dataset and write data in
         Dataset write(const std::string &name, const void* buffer, const DType &dt, const DSpace &space, const DProps& props = DProps::DEFAULT) {
             //create and write in one fell swoop
@@ -1219,7 +3961,20 @@ namespace H5TL {
         }
         template<typename data_t>
         Dataset write(const std::string &name, const data_t& buffer, const DProps &props = DProps::DEFAULT) {
-            return write(name, H5TL::data(buffer), H5TL::dtype(buffer), H5TL::space(buffer), props);
+            Dataset dset = createDataset(name, H5TL::dtype(buffer), H5TL::space(buffer), props);
+            dset.write(buffer);
+            return dset;
+        }
+        ///write packed flags, as bytes with the number of flags in the H5TL_bits attribute. Read with read<BitMask>()
+        Dataset write(const std::string &name, const BitMask& mask, const DProps &props = DProps::DEFAULT) {
+            Dataset dset = write(name, mask.data(), DType::BITS8, DSpace({ hsize_t(mask.nbytes()) }), props);
+            dset.writeAttribute("H5TL_bits", uint64_t(mask.size()));
+            return dset;
+        }
+        ///write flags packed, like BitMask. Read with read<std::vector<bool>>()
+        template<typename A>
+        Dataset write(const std::string &name, const std::vector<bool, A>& flags, const DProps &props = DProps::DEFAULT) {
+            return write(name, BitMask(flags), props);
         }
         //open and read dataset
         Dataset read(const std::string &name, void* buffer, const DType& buffer_type, const DSpace& buffer_shape, const Selection& selection = Selection::ALL) {
@@ -1241,11 +3996,15 @@ namespace H5TL {
         }
         template<typename data_t>
         Dataset read(const std::string &name, data_t& buffer, const Selection& selection = Selection::ALL) {
-            return read(name, H5TL::data(buffer), H5TL::dtype(buffer), H5TL::space(buffer), selection);
+            Dataset ds = dataset(name);
+            ds.read(buffer, selection);
+            return ds;
         }
         template<typename data_t>
         Dataset read(const std::string &name, data_t& buffer, const std::vector<hsize_t>& offset) {
-            return read(name, H5TL::data(buffer), H5TL::dtype(buffer), H5TL::space(buffer), offset);
+            Dataset ds = dataset(name);
+            ds.read(buffer, offset);
+            return ds;
         }
         //read with pointer to buffer
         template<typename data_t>
@@ -1279,63 +4038,144 @@ namespace H5TL {
         }
         //linking
         void createHardLink(const std::string& name, const Group& target_group, const std::string& target) {
-            check(H5Lcreate_hard(target_group, target.c_str(), id, name.c_str(), LProps::DEFAULT, H5P_LINK_ACCESS_DEFAULT));
+            check(H5TL_PROFILED("H5Lcreate_hard", id, 0, H5Lcreate_hard(target_group, target.c_str(), id, name.c_str(), LProps::DEFAULT, H5P_LINK_ACCESS_DEFAULT)));
         }
         void createHardLink(const std::string& name, const std::string& target) {
             createHardLink(name, *this, target);
         }
         void createHardLink(const std::string& name, const Object& target) {
-            check(H5Olink(target, id, name.c_str(), LProps::DEFAULT, H5P_LINK_ACCESS_DEFAULT));
+            check(H5TL_PROFILED("H5Olink", id, 0, H5Olink(target, id, name.c_str(), LProps::DEFAULT, H5P_LINK_ACCESS_DEFAULT)));
         }
         void createLink(const std::string& name, const std::string& target) {
-            check(H5Lcreate_soft(target.c_str(), id, name.c_str(), LProps::DEFAULT, H5P_LINK_ACCESS_DEFAULT));
+            check(H5TL_PROFILED("H5Lcreate_soft", id, 0, H5Lcreate_soft(target.c_str(), id, name.c_str(), LProps::DEFAULT, H5P_LINK_ACCESS_DEFAULT)));
         }
         void createLink(const std::string& name, const std::string& file, const std::string& target) {
-            check(H5Lcreate_external(file.c_str(), target.c_str(), id, name.c_str(), LProps::DEFAULT, H5P_LINK_ACCESS_DEFAULT));
+            check(H5TL_PROFILED("H5Lcreate_external", id, 0, H5Lcreate_external(file.c_str(), target.c_str(), id, name.c_str(), LProps::DEFAULT, H5P_LINK_ACCESS_DEFAULT)));
         }
     };
 
     //Files
     class File : public Group {
+    protected:
+        //a name for a file in memory, unused by any other in this process, eg. "h5tl-image-3"
+        static std::string memory_name(const char* kind) {
+            static std::atomic<unsigned long long> n(0);
+            return "h5tl-" + std::string(kind) + "-" + std::to_string(++n);
+        }
     public:
         enum OpenMode : unsigned int {
 #pragma push_macro("H5CHECK") //compatible with MSVC, gcc, clang
+#pragma push_macro("H5OPEN")
 #undef H5CHECK
+#undef H5OPEN
 #define H5CHECK //need to make this not call H5check() so that the following expressions are constant:
+#define H5OPEN //HDF5 1.10 also calls H5open() in these expressions
             TRUNCATE = H5F_ACC_TRUNC,
             CREATE = H5F_ACC_EXCL,
             READ_WRITE = H5F_ACC_RDWR,
-            READ = H5F_ACC_RDONLY
+            READ = H5F_ACC_RDONLY,
+            SWMR_WRITE = H5F_ACC_RDWR | H5F_ACC_SWMR_WRITE, ///< Open an existing file for single-writer/multiple-reader writing
+            SWMR_READ = H5F_ACC_RDONLY | H5F_ACC_SWMR_READ ///< Open a file for reading while a SWMR writer appends to it
+#pragma pop_macro("H5OPEN")
 #pragma pop_macro("H5CHECK")
         };
-        File(const std::string& name, const OpenMode& mode = READ_WRITE) {
-            open(name, mode);
+        File(const std::string& name, const OpenMode& mode = READ_WRITE, const FAProps& fapl = FAProps::DEFAULT) {
+            open(name, mode, fapl);
         }
         File() {}
-        //no copy!
+        //copy shares the file, which stays open until every copy is closed
+        File(const File &f) : Group(f) {}
+        File& operator=(const File& f) {
+            File tmp(f);
+            steal(tmp);
+            return *this;
+        }
         //move
-        File(File&& f) : Group(std::move(f)) {}
+        File(File&& f) noexcept : Group(std::move(f)) {}
         File& operator=(File&& f) {
             steal(f);
             return *this;
         }
-        virtual ~File() {
+        ~File() {
             if (id) close();
         }
-        virtual void open(const std::string& name, const OpenMode& mode = READ_WRITE) {
+        void open(const std::string& name, const OpenMode& mode = READ_WRITE, const FAProps& fapl = FAProps::DEFAULT) {
             if (id) close();
+            filters::register_builtin();
+#ifdef H5TL_FAST_CONVERT
+            convert::register_fast();
+#endif
             if (mode == TRUNCATE || mode == CREATE) {
-                id = check_id(H5Fcreate(name.c_str(), mode, H5P_FILE_CREATE_DEFAULT, H5P_FILE_ACCESS_DEFAULT));
+                id = check_id(H5TL_PROFILED("H5Fcreate", 0, 0, H5Fcreate(name.c_str(), mode, H5P_FILE_CREATE_DEFAULT, fapl)));
+            }
+            else if (mode == SWMR_WRITE) {
+                //SWMR writing needs the latest file format
+                FAProps latest(fapl);
+                latest.libver_latest();
+                id = check_id(H5TL_PROFILED("H5Fopen", 0, 0, H5Fopen(name.c_str(), mode, latest)));
             }
             else {
-                hid_t tmp_id = H5Fopen(name.c_str(), mode, H5P_FILE_ACCESS_DEFAULT);
-                if (tmp_id < 0) //if we failed to open, let's try creating the file
-                    tmp_id = H5Fcreate(name.c_str(), CREATE, H5P_FILE_CREATE_DEFAULT, H5P_FILE_ACCESS_DEFAULT);
+                hid_t tmp_id = H5TL_PROFILED("H5Fopen", 0, 0, H5Fopen(name.c_str(), mode, fapl));
+                if (tmp_id < 0 && mode == READ_WRITE) //if we failed to open for writing, let's try creating the file
+                    tmp_id = H5TL_PROFILED("H5Fcreate", 0, 0, H5Fcreate(name.c_str(), CREATE, H5P_FILE_CREATE_DEFAULT, fapl));
                 id = check_id(tmp_id);
             }
         }
-        virtual void close() {
-            check(H5Fclose(id)); id = 0;
+        /** \brief Switch a file open for writing into SWMR writing mode.
+        *
+        * The file must use the latest format (create it with FAProps().libver_latest()), and every object to be
+        * written must already exist: after this, datasets may only be written, extended and flushed. Readers open the
+        * file with SWMR_READ, and see new data after Dataset::refresh().
+        */
+        void start_swmr_write() {
+            check(H5TL_PROFILED("H5Fstart_swmr_write", id, 0, H5Fstart_swmr_write(id)));
+        }
+        ///flush all buffers for the file to disk
+        void flush() {
+            check(H5TL_PROFILED("H5Fflush", id, 0, H5Fflush(id, H5F_SCOPE_GLOBAL)));
+        }
+        /** \brief Create a file that lives in memory only, and is never written to disk.
+        *
+        * Use to_bytes() to get its contents. HDF5 gives back the open file when a file of the same name is opened again,
+        * so each call gets a unique name unless one is given.
+        */
+        static File in_memory(const std::string& name = std::string(), size_t increment = size_t(1) << 20) {
+            return File(name.empty() ? memory_name("memory") : name, TRUNCATE, FAProps().core(increment, false));
+        }
+        /** \brief Open a file in memory from a copy of its image, as returned by to_bytes().
+        *
+        * Changes, if the mode allows them, are made to the copy. name only identifies the file, and is unique unless
+        * given: opening two images under one name would give back the first.
+        */
+        static File from_bytes(const void* data, size_t nbytes, const OpenMode& mode = READ, const std::string& name = std::string()) {
+            filters::register_builtin();
+#ifdef H5TL_FAST_CONVERT
+            convert::register_fast();
+#endif
+            File f;
+            FAProps fapl = FAProps().core(nbytes, false).file_image(data, nbytes);
+            std::string unique = name.empty() ? memory_name("image") : name;
+            f.id = check_id(H5TL_PROFILED("H5Fopen", 0, 0, H5Fopen(unique.c_str(), mode == READ ? H5F_ACC_RDONLY : H5F_ACC_RDWR, fapl)));
+            return f;
+        }
+        static File from_bytes(const std::vector<char>& bytes, const OpenMode& mode = READ, const std::string& name = std::string()) {
+            return from_bytes(bytes.data(), bytes.size(), mode, name);
+        }
+        ///Copy the current contents of the file, as they would be on disk
+        std::vector<char> to_bytes() const {
+            //the image is taken from the file's storage, so cached metadata has to be written there first
+            check(H5TL_PROFILED("H5Fflush", id, 0, H5Fflush(id, H5F_SCOPE_LOCAL)));
+            ssize_t nbytes = check_ssize(H5TL_PROFILED("H5Fget_file_image", id, 0, H5Fget_file_image(id, nullptr, 0)));
+            std::vector<char> bytes(nbytes);
+            check_ssize(H5TL_PROFILED("H5Fget_file_image", id, nbytes, H5Fget_file_image(id, bytes.data(), bytes.size())));
+            return bytes;
+        }
+        void close() {
+            hid_t file = id;
+            check(H5TL_PROFILED_CLOSE("H5Fclose", id, H5Fclose(id))); id = 0;
+            //copies share the id, which stays valid until the last of them closes
+            if (H5Iis_valid(file) <= 0)
+                detail::forget_stats_file(file);
         }
     };
 }
@@ -1363,6 +4203,9 @@ static dtype_return dtype(const data_t&);
 static data_return data(data_t&);
 static const_data_return data(const data_t&);
 static allocate_return allocate(const std::vector<hsize_t>&, const DType&);
+//optional: the distance between neighbors along each dimension, in elements, for data not laid out in C order.
+//data() must point at the first element. See H5TL::memory_space()
+static std::vector<hssize_t> strides(const data_t&);
 };
 */
 namespace H5TL {
@@ -1444,7 +4287,7 @@ namespace H5TL {
         static allocate_return allocate(const std::vector<hsize_t>& shape, const DType&) {
             if (util::product(begin(shape), end(shape), hsize_t(1)) != N)
                 throw std::runtime_error("Cannot allocate fixed sized array with conflicting shape = {" + util::join(", ", shape.begin(), shape.end()) + "}");
-            return new data_t[N];
+            return detail::allocate_array<data_t>(N);
         }
     };
 
@@ -1473,6 +4316,15 @@ namespace H5TL {
             return nullptr;
         }
     };
+    //string literals passed as const data_t& deduce data_t = char[N], which must not fall through to the array adapter
+    template<size_t N>
+    struct adapt<char[N]> : adapt<const char[N]> {
+        typedef char* data_return;
+        using adapt<const char[N]>::data;
+        static data_return data(char(&d)[N]) {
+            return std::begin(d);
+        }
+    };
 
     //pointer adapter
     template<typename cvptr_t>
@@ -1505,8 +4357,7 @@ namespace H5TL {
             return p;
         }
         static allocate_return allocate(const std::vector<hsize_t>& shape, const DType&) {
-            size_t n = util::product(shape.begin(), shape.end(), hsize_t(1));
-            return new data_t[n];
+            return detail::allocate_array<data_t>(util::product(shape.begin(), shape.end(), size_t(1)));
         }
     };
     //void pointer adapter
@@ -1528,9 +4379,69 @@ namespace H5TL {
         }
         static allocate_return allocate(const std::vector<hsize_t>& shape, const DType& dt) {
             size_t n = util::product(shape.begin(), shape.end(), hsize_t(dt.size()));
-            return ::operator new[](n);
+            const allocation& a = detail::current_allocation();
+            return a.allocate ? a.allocate(n) : ::operator new[](n);
         }
     };
+
+    //BitMask adapter: the packed bytes. Group::write() and Dataset::read<BitMask>() also keep the number of flags
+    template<>
+    struct adapt<BitMask> {
+        typedef const DType& dtype_return;
+        typedef uint8_t* data_return;
+        typedef const uint8_t* const_data_return;
+        typedef BitMask allocate_return;
+
+        static size_t rank(const BitMask&) {
+            return 1;
+        }
+        static std::vector<hsize_t> shape(const BitMask& m) {
+            return std::vector<hsize_t>(1, m.nbytes());
+        }
+        static dtype_return dtype(const BitMask&) {
+            return DType::BITS8;
+        }
+        static data_return data(BitMask& m) {
+            return m.data();
+        }
+        static const_data_return data(const BitMask& m) {
+            return m.data();
+        }
+        static allocate_return allocate(const std::vector<hsize_t>& shape, const DType&) {
+            return BitMask(size_t(util::product(shape.begin(), shape.end(), hsize_t(1))) * 8);
+        }
+    };
+    namespace detail {
+        //number of flags in a dataset of packed bytes
+        inline uint64_t bit_count(Dataset& ds) {
+            if (ds.hasAttribute("H5TL_bits")) {
+                uint64_t n;
+                ds.readAttribute("H5TL_bits", n);
+                return n;
+            }
+            return uint64_t(ds.space().count()) * 8;
+        }
+    }
+    ///read the flags written by Group::write(name, BitMask)
+    template<>
+    inline BitMask Dataset::read<BitMask>() {
+        BitMask mask(size_t(detail::bit_count(*this)));
+        read(mask.data(), DType::BITS8, DSpace({ hsize_t(mask.nbytes()) }), Hyperslab({ 0 }, { hsize_t(mask.nbytes()) }));
+        return mask;
+    }
+    ///read buffer_shape[0] flags, starting from flag offset[0]
+    template<>
+    inline BitMask Dataset::read<BitMask>(const std::vector<hsize_t>& buffer_shape, const std::vector<hsize_t>& offset) {
+        if (buffer_shape.size() != 1 || offset.size() != 1)
+            throw std::runtime_error("BitMask reads are 1-dimensional");
+        hsize_t first = offset[0], n = buffer_shape[0];
+        if (first + n > detail::bit_count(*this))
+            throw std::runtime_error("Cannot read flags past the end of the BitMask");
+        hsize_t begin = first / 8, end = (first + n + 7) / 8;
+        aligned_vector<uint8_t> packed(size_t(end - begin));
+        read(packed.data(), DType::BITS8, DSpace({ end - begin }), Hyperslab({ begin }, { end - begin }));
+        return BitMask::from_bytes(packed.data(), size_t(first - begin * 8), size_t(n));
+    }
 }
 
 
@@ -1571,21 +4482,55 @@ namespace H5TL {
         }
     };
 
-    //std::array
+    namespace detail {
+        //the elements of std::array and std::vector may themselves be std::arrays, nested to any depth. Their shape is
+        //known at compile time and they're stored contiguously, so e.g. a vector<array<float, 3>> is one buffer of shape {n, 3}
+        template<typename T>
+        struct nested {
+            typedef T scalar;
+            static const size_t rank = 0;
+            static const size_t count = 1;
+            static void shape(std::vector<hsize_t>&) {}
+        };
+        template<typename T, size_t N>
+        struct nested<std::array<T, N>> {
+            static_assert(sizeof(std::array<T, N>) == N * sizeof(T), "std::array<T, N> is padded, so nested arrays of it aren't contiguous.");
+            typedef typename nested<T>::scalar scalar;
+            static const size_t rank = 1 + nested<T>::rank;
+            static const size_t count = N * nested<T>::count;
+            static void shape(std::vector<hsize_t>& s) {
+                s.push_back(hsize_t(N));
+                nested<T>::shape(s);
+            }
+        };
+        //whether the last dimensions of shape are T's shape, less any leading 1s, so its items group into Ts as they are
+        template<typename T>
+        bool ends_in(const std::vector<hsize_t>& shape) {
+            std::vector<hsize_t> inner;
+            nested<T>::shape(inner);
+            auto first = std::find_if(inner.begin(), inner.end(), [](hsize_t d) { return d != 1; });
+            size_t n = size_t(inner.end() - first);
+            return shape.size() >= n && std::equal(first, inner.end(), shape.end() - n);
+        }
+    }
+
+    //std::array, of scalars or nested std::arrays
     template<typename T, size_t N>
     struct adapt<std::array<T, N>, void> {
-        typedef T data_t;
+        typedef typename detail::nested<T>::scalar data_t;
         typedef typename bool_to_int<data_t>::type data_nbt;
         typedef const DType& dtype_return;
         typedef data_nbt* data_return;
         typedef const data_nbt* const_data_return;
-        typedef std::array<data_t, N> allocate_return;
+        typedef std::array<T, N> allocate_return;
 
         static size_t rank(const std::array<T, N>&) {
-            return 1;
+            return detail::nested<std::array<T, N>>::rank;
         }
         static std::vector<hsize_t> shape(const std::array<T, N>&) {
-            return std::vector<hsize_t>(1, hsize_t(N));
+            std::vector<hsize_t> tmp;
+            detail::nested<std::array<T, N>>::shape(tmp);
+            return tmp;
         }
         static dtype_return dtype(const std::array<T, N>&) {
             return H5TL::pdtype(data_nbt());
@@ -1597,16 +4542,18 @@ namespace H5TL {
             return (const_data_return)d.data();
         }
         static allocate_return allocate(const std::vector<hsize_t>& shape, const DType&) {
-            if (util::product(shape.begin(), shape.end(), hsize_t(1)) != N)
+            //nested arrays must match the dataset's shape; a flat array only its size
+            if (util::product(shape.begin(), shape.end(), hsize_t(1)) != detail::nested<std::array<T, N>>::count
+                || (detail::nested<T>::rank > 0 && !detail::ends_in<std::array<T, N>>(shape)))
                 throw std::runtime_error("Cannot allocate std::array<T,N> with shape = {" + util::join(", ", shape.begin(), shape.end()) + "}.");
             return std::array<T, N>();
         }
     };
 
-    //std::vector
+    //std::vector, of scalars or nested std::arrays
     template<typename T, typename A>
     struct adapt<std::vector<T,A>> {
-        typedef T data_t;
+        typedef typename detail::nested<T>::scalar data_t;
         typedef typename bool_to_int<data_t>::type data_nbt;
         typedef const DType& dtype_return;
         typedef data_nbt* data_return;
@@ -1614,10 +4561,12 @@ namespace H5TL {
         typedef std::vector<T,A> allocate_return;
 
         static size_t rank(const std::vector<T,A>&) {
-            return 1;
+            return 1 + detail::nested<T>::rank;
         }
         static std::vector<hsize_t> shape(const std::vector<T,A>& v) {
-            return std::vector<hsize_t>(1, v.size());
+            std::vector<hsize_t> tmp(1, v.size());
+            detail::nested<T>::shape(tmp);
+            return tmp;
         }
         static dtype_return dtype(const std::vector<T,A>&) {
             return H5TL::pdtype(data_nbt());
@@ -1628,12 +4577,1010 @@ namespace H5TL {
         static const_data_return data(const std::vector<T,A>& v) {
             return (const_data_return)v.data();
         }
+        //the dataset's elements are grouped into Ts, e.g. a shape {n, 3} dataset becomes n array<float, 3>s. Its last
+        //dimensions must be T's shape: a shape {3, 2} dataset isn't regrouped into 2 array<float, 3>s
         static allocate_return allocate(const std::vector<hsize_t>& shape, const DType&) {
-            return std::vector<T,A>(util::product(shape.begin(), shape.end(), hsize_t(1)));
+            hsize_t n = util::product(shape.begin(), shape.end(), hsize_t(1)), count = detail::nested<T>::count;
+            if (!detail::ends_in<T>(shape))
+                throw std::runtime_error("Cannot allocate std::vector<T> with shape = {" + util::join(", ", shape.begin(), shape.end()) + "}, which doesn't end in the shape of T.");
+            return std::vector<T,A>(size_t(n / count));
         }
     };
+
+    //std::vector<bool> has no array of bools to point to: it is written packed, like BitMask
+    template<typename A>
+    struct adapt<std::vector<bool, A>> {
+        typedef std::vector<bool, A> allocate_return;
+
+        static size_t rank(const std::vector<bool, A>&) {
+            return 1;
+        }
+        static std::vector<hsize_t> shape(const std::vector<bool, A>& v) {
+            return std::vector<hsize_t>(1, v.size());
+        }
+        static allocate_return allocate(const std::vector<hsize_t>& shape, const DType&) {
+            return std::vector<bool, A>(util::product(shape.begin(), shape.end(), hsize_t(1)));
+        }
+    };
+    ///read the flags written by Group::write(name, std::vector<bool>)
+    template<>
+    inline std::vector<bool> Dataset::read<std::vector<bool>>() {
+        return read<BitMask>().to_vector();
+    }
+    template<>
+    inline std::vector<bool> Dataset::read<std::vector<bool>>(const std::vector<hsize_t>& buffer_shape, const std::vector<hsize_t>& offset) {
+        return read<BitMask>(buffer_shape, offset).to_vector();
+    }
 }
+
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+#ifdef __cpp_lib_mdspan
+#include <mdspan>
+namespace H5TL {
+    //std::mdspan, with a strided layout (layout_right, layout_left or layout_stride). Reads and writes go through
+    //its strides, in place where HDF5 can select them. It views memory it doesn't own, so it can't be allocated
+    template<typename T, typename E, typename L, typename A>
+    struct adapt<std::mdspan<T, E, L, A>> {
+        static_assert(std::is_pointer<typename A::data_handle_type>::value, "H5TL::adapt<std::mdspan> needs an accessor with pointer data handles.");
+        typedef typename std::remove_const<T>::type data_t;
+        typedef typename bool_to_int<data_t>::type data_nbt;
+        typedef const DType& dtype_return;
+        typedef data_nbt* data_return;
+        typedef const data_nbt* const_data_return;
+        typedef std::mdspan<T, E, L, A> allocate_return;
+
+        static size_t rank(const std::mdspan<T, E, L, A>&) {
+            return E::rank();
+        }
+        static std::vector<hsize_t> shape(const std::mdspan<T, E, L, A>& d) {
+            std::vector<hsize_t> tmp(E::rank());
+            for (size_t k = 0; k < E::rank(); ++k)
+                tmp[k] = hsize_t(d.extent(k));
+            return tmp;
+        }
+        static std::vector<hssize_t> strides(const std::mdspan<T, E, L, A>& d) {
+            std::vector<hssize_t> tmp(E::rank());
+            for (size_t k = 0; k < E::rank(); ++k)
+                tmp[k] = hssize_t(d.stride(k));
+            return tmp;
+        }
+        static dtype_return dtype(const std::mdspan<T, E, L, A>&) {
+            return H5TL::pdtype(data_nbt());
+        }
+        static data_return data(std::mdspan<T, E, L, A>& d) {
+            return (data_return)d.data_handle();
+        }
+        static const_data_return data(const std::mdspan<T, E, L, A>& d) {
+            return (const_data_return)d.data_handle();
+        }
+        static allocate_return allocate(const std::vector<hsize_t>&, const DType&) {
+            static_assert(util::falseish<T>::value, "Cannot allocate std::mdspan, which doesn't own its memory. Read into an existing mdspan instead.");
+            return allocate_return();
+        }
+    };
+}
+#endif
+#endif
+
+//Concurrent reading
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <map>
+#include <cstring>
+#include <atomic>
+
+namespace H5TL {
+    /** \brief Lock for calling HDF5 from multiple threads.
+    *
+    * A threadsafe HDF5 build serializes API calls itself, so the returned lock is empty. Otherwise it holds a mutex
+    * shared by all H5TL worker threads. Calls made from other threads are not covered by it.
+    */
+    inline std::unique_lock<std::mutex> hdf5_lock() {
+#ifdef H5_HAVE_THREADSAFE
+        return std::unique_lock<std::mutex>();
+#else
+        static std::mutex m;
+        return std::unique_lock<std::mutex>(m);
+#endif
+    }
+
+    /** \brief Pool of worker threads servicing Dataset reads from many threads.
+    *
+    * The pool opens the file read-only once, and its workers share the open datasets, and so their chunk caches.
+    * Queued requests are hyperslab reads, described by an offset and the buffer shape, like
+    * Dataset::read(buffer, buffer_shape, offset). A worker that picks up a request also takes any other queued requests
+    * on the same dataset with the same type and the same selection in all but the slowest dimension, if their rows are
+    * adjacent to it or fall in the same chunk. The merged run is read with one H5Dread into a staging buffer and copied
+    * out to each request's buffer.
+    */
+    class ReaderPool {
+    protected:
+        struct request {
+            std::string path;
+            void* buffer;
+            DType type;
+            //the encoded type, so requests are matched without calling HDF5 while the queue is locked
+            std::string type_key;
+            std::vector<hsize_t> offset, count;
+            std::promise<void> done;
+            //for strided memory: buffer is staged, a C-ordered copy, which is scattered to memory after the read.
+            //The layout holds a dataspace, so it is made and released with hdf5_lock() held, like type
+            std::unique_ptr<detail::strided_layout> layout;
+            std::vector<char> staged;
+            void* memory;
+            size_t item_nbytes;
+            hsize_t begin() const { return offset[0]; }
+            hsize_t end() const { return offset[0] + count[0]; }
+            //can this request be read in the same H5Dread as r?
+            bool compatible(const request& r) const {
+                return path == r.path && offset.size() == r.offset.size() && offset.size() > 0
+                    && std::equal(offset.begin() + 1, offset.end(), r.offset.begin() + 1)
+                    && std::equal(count.begin() + 1, count.end(), r.count.begin() + 1)
+                    && type_key == r.type_key;
+            }
+        };
+        //equal types encode to the same bytes. Call with hdf5_lock() held
+        static std::string type_key(const DType& type) {
+            size_t n = 0;
+            check(H5Tencode(type, nullptr, &n));
+            std::string key(n, '\0');
+            check(H5Tencode(type, &key[0], &n));
+            return key;
+        }
+        //an open dataset, and the number of rows in a chunk (1 if not chunked)
+        struct source {
+            Dataset dset;
+            hsize_t chunk_rows;
+        };
+
+        File file;
+        std::map<std::string, source> sources;
+        std::mutex sources_mutex;
+        std::vector<std::thread> workers;
+        std::deque<request> queue;
+        std::mutex queue_mutex;
+        std::condition_variable queue_cv;
+        bool stopping;
+
+        source& open(const std::string& path) {
+            std::lock_guard<std::mutex> guard(sources_mutex);
+            auto it = sources.find(path);
+            if (it == sources.end()) {
+                auto lock = hdf5_lock();
+                source src = { file.dataset(path), 1 };
+                DProps props = src.dset.props();
+                //check the filters once here, rather than failing each of the reads merged later
+                props.require_filters();
+                auto chunk = props.chunk();
+                if (chunk.size() > 0)
+                    src.chunk_rows = chunk[0];
+                it = sources.insert(std::make_pair(path, std::move(src))).first;
+            }
+            return it->second;
+        }
+        hsize_t chunk_rows(const std::string& path) {
+            //chunk-sharing requests are only merged once a worker has opened the dataset and knows its chunking
+            std::lock_guard<std::mutex> guard(sources_mutex);
+            auto it = sources.find(path);
+            return it == sources.end() ? 1 : it->second.chunk_rows;
+        }
+        //pop the next request and all compatible, coalescable requests from the queue. Call with queue_mutex held.
+        std::vector<request> take() {
+            std::vector<request> batch;
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+            hsize_t chunk = chunk_rows(batch.front().path);
+            hsize_t lo = batch.front().begin(), hi = batch.front().end();
+            //keep sweeping the queue until nothing else merges, since each merge can widen the run
+            bool merged = true;
+            while (merged) {
+                merged = false;
+                for (auto it = queue.begin(); it != queue.end();) {
+                    //merge if the rows overlap, touch, or share a chunk with the current run
+                    bool near = it->begin() <= hi && it->end() >= lo;
+                    near = near || (it->begin() > hi && it->begin() / chunk == (hi - 1) / chunk);
+                    near = near || (it->end() < lo && (it->end() - 1) / chunk == lo / chunk);
+                    if (near && it->compatible(batch.front())) {
+                        lo = std::min(lo, it->begin());
+                        hi = std::max(hi, it->end());
+                        batch.push_back(std::move(*it));
+                        it = queue.erase(it);
+                        merged = true;
+                    }
+                    else {
+                        ++it;
+                    }
+                }
+            }
+            return batch;
+        }
+        void read(std::vector<request>& batch) {
+            Dataset& dset = open(batch.front().path).dset;
+            if (batch.size() == 1) {
+                //nothing to merge -- read straight into the caller's buffer
+                request& r = batch.front();
+                auto lock = hdf5_lock();
+                dset.read(r.buffer, r.type, DSpace(r.count), r.offset);
+                return;
+            }
+            hsize_t lo = batch.front().begin(), hi = batch.front().end();
+            for (auto& r : batch) {
+                lo = std::min(lo, r.begin());
+                hi = std::max(hi, r.end());
+            }
+            std::vector<hsize_t> offset(batch.front().offset), count(batch.front().count);
+            offset[0] = lo;
+            count[0] = hi - lo;
+            size_t row_nbytes = batch.front().type.size() * util::product(count.begin() + 1, count.end(), size_t(1));
+            std::vector<char> staging(row_nbytes * count[0]);
+            {
+                auto lock = hdf5_lock();
+                dset.read(staging.data(), batch.front().type, DSpace(count), offset);
+            }
+            for (auto& r : batch)
+                std::memcpy(r.buffer, staging.data() + (r.begin() - lo)*row_nbytes, size_t(r.count[0])*row_nbytes);
+        }
+        //queue a read of buffer_shape at offset into buffer, or into a copy scattered to buffer as layout says
+        std::future<void> enqueue(const std::string& path, void* buffer, const DType& buffer_type, const std::vector<hsize_t>& buffer_shape,
+            const std::vector<hsize_t>& offset, std::unique_ptr<detail::strided_layout> layout) {
+            if (buffer_shape.size() != offset.size())
+                throw std::runtime_error("buffer_shape and offset must be same size.");
+            request r;
+            r.path = path;
+            r.buffer = r.memory = buffer;
+            r.offset = offset;
+            r.count = buffer_shape;
+            {
+                auto lock = hdf5_lock();
+                r.type = buffer_type.share();
+                r.type_key = type_key(r.type);
+                r.item_nbytes = r.type.size();
+                if (layout) {
+                    r.staged.resize(size_t(util::product(buffer_shape.begin(), buffer_shape.end(), hsize_t(1))) * r.item_nbytes);
+                    r.buffer = r.staged.data();
+                    r.layout = std::move(layout);
+                }
+            }
+            std::future<void> f = r.done.get_future();
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                queue.push_back(std::move(r));
+            }
+            queue_cv.notify_one();
+            return f;
+        }
+        void work() {
+            ErrorHandler::init_thread();
+            for (;;) {
+                std::vector<request> batch;
+                {
+                    std::unique_lock<std::mutex> lock(queue_mutex);
+                    queue_cv.wait(lock, [this]{ return stopping || !queue.empty(); });
+                    if (queue.empty())
+                        break;
+                    batch = take();
+                }
+                try {
+                    read(batch);
+                    for (auto& r : batch)
+                        if (r.layout) detail::stage(*r.layout, r.item_nbytes, r.staged.data(), (char*)r.memory, true);
+                    for (auto& r : batch)
+                        r.done.set_value();
+                }
+                catch (...) {
+                    for (auto& r : batch)
+                        r.done.set_exception(std::current_exception());
+                }
+                auto lock = hdf5_lock();
+                batch.clear();
+            }
+        }
+    public:
+        /** \brief Open the file and start the worker threads.
+        * \param[in] filename The file to read, opened read-only.
+        * \param[in] nthreads The number of workers. Defaults to the number of hardware threads.
+        */
+        explicit ReaderPool(const std::string& filename, size_t nthreads = 0) : file(filename, File::READ), stopping(false) {
+            if (nthreads == 0)
+                nthreads = std::max(1u, std::thread::hardware_concurrency());
+            for (size_t i = 0; i < nthreads; ++i)
+                workers.emplace_back(&ReaderPool::work, this);
+        }
+        //not copyable or movable -- the workers hold a pointer to the pool
+        ReaderPool(const ReaderPool&) = delete;
+        ReaderPool& operator=(const ReaderPool&) = delete;
+        ///finishes all queued reads, then stops the workers
+        ~ReaderPool() {
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                stopping = true;
+            }
+            queue_cv.notify_all();
+            for (auto& w : workers)
+                w.join();
+        }
+        size_t size() const {
+            return workers.size();
+        }
+        /** \brief Queue a hyperslab read.
+        *
+        * Reads the block of shape buffer_shape at offset from the dataset at path into buffer. buffer must stay valid
+        * until the returned future is ready; errors are delivered through the future.
+        */
+        std::future<void> read(const std::string& path, void* buffer, const DType& buffer_type, const std::vector<hsize_t>& buffer_shape, const std::vector<hsize_t>& offset) {
+            return enqueue(path, buffer, buffer_type, buffer_shape, offset, nullptr);
+        }
+        ///buffer is read in place if it is in C order, or else through a C-ordered copy made now
+        template<typename data_t>
+        std::future<void> read(const std::string& path, data_t& buffer, const std::vector<hsize_t>& buffer_shape, const std::vector<hsize_t>& offset) {
+            if (buffer_shape.size() != offset.size())
+                throw std::runtime_error("buffer_shape and offset must be same size.");
+            std::unique_ptr<detail::strided_layout> layout;
+            {
+                auto lock = hdf5_lock();
+                detail::strided_layout l = detail::memory_layout(buffer);
+                if (!detail::in_c_order(l)) {
+                    if (util::product(buffer_shape.begin(), buffer_shape.end(), hsize_t(1)) != util::product(l.shape.begin(), l.shape.end(), hsize_t(1)))
+                        throw std::runtime_error("buffer_shape must hold as many items as a strided buffer.");
+                    layout.reset(new detail::strided_layout(std::move(l)));
+                }
+            }
+            return enqueue(path, H5TL::data(buffer), H5TL::dtype(buffer), buffer_shape, offset, std::move(layout));
+        }
+        template<typename data_t>
+        std::future<void> read(const std::string& path, data_t* buffer, const std::vector<hsize_t>& buffer_shape, const std::vector<hsize_t>& offset) {
+            return read(path, H5TL::data(buffer), H5TL::dtype(buffer), buffer_shape, offset);
+        }
+    };
+
+    /** \brief Downsampled copies of a 2D dataset, for zoomable views of large images.
+    *
+    * Level 0 is the source. Each level after it halves the one before in both dimensions, as Downsample says, until a
+    * level fits in one tile. The levels are the datasets "0", "1", ... of the pyramid's group, "0" being a hard link to
+    * the source, and the rest are chunked in tiles and keep the source's filters. Group::createPyramid() makes each level
+    * a tile at a time, on a pool of threads: reads and writes take turns through hdf5_lock(), while downsampling runs
+    * concurrently. To fetch a region of the source at a lower resolution, tile() finds it in the coarsest level that
+    * still has that resolution, and read() reads it there, touching only the chunks under it.
+    */
+    class Pyramid {
+        friend class Group;
+    public:
+        ///where a region of level 0 lies in a level: its offset and shape there
+        struct Tile {
+            size_t level;
+            std::vector<hsize_t> offset, shape;
+        };
+    protected:
+        Group grp;
+        std::vector<Dataset> levels;
+        std::vector<std::vector<hsize_t>> extents;
+
+        //downsample in_rows x in_cols items into rows x cols, each from a 2x2 block. Blocks cut off by the edge of the
+        //input repeat their last row or column, which leaves the mean and maximum of what's there unchanged
+        typedef void(*reducer)(const void*, hsize_t, hsize_t, void*, hsize_t, hsize_t);
+        struct mean_of {
+            template<typename T>
+            static T apply(T a, T b, T c, T d) {
+                double m = (double(a) + double(b) + double(c) + double(d)) * 0.25;
+                return T(std::is_integral<T>::value ? std::floor(m + 0.5) : m);
+            }
+        };
+        struct max_of {
+            template<typename T>
+            static T apply(T a, T b, T c, T d) {
+                return std::max(std::max(a, b), std::max(c, d));
+            }
+        };
+        struct first_of {
+            template<typename T>
+            static T apply(T a, T, T, T) {
+                return a;
+            }
+        };
+        template<typename T, typename Op>
+        static void reduce(const void* input, hsize_t in_rows, hsize_t in_cols, void* output, hsize_t rows, hsize_t cols) {
+            const T* in = (const T*)input;
+            T* out = (T*)output;
+            hsize_t full = std::min(cols, in_cols / 2);
+            for (hsize_t i = 0; i < rows; ++i) {
+                const T* H5TL_RESTRICT r0 = in + 2 * i * in_cols;
+                const T* H5TL_RESTRICT r1 = 2 * i + 1 < in_rows ? r0 + in_cols : r0;
+                T* H5TL_RESTRICT o = out + i * cols;
+                for (hsize_t j = 0; j < full; ++j)
+                    o[j] = Op::apply(r0[2 * j], r0[2 * j + 1], r1[2 * j], r1[2 * j + 1]);
+                if (full < cols)
+                    o[full] = Op::apply(r0[2 * full], r0[2 * full], r1[2 * full], r1[2 * full]);
+            }
+        }
+        template<typename T>
+        static reducer pick(Downsample method) {
+            switch (method) {
+            case Downsample::MEAN: return &reduce<T, mean_of>;
+            case Downsample::MAX: return &reduce<T, max_of>;
+            default: return &reduce<T, first_of>;
+            }
+        }
+        static reducer pick(const DType& native, Downsample method) {
+            if (native == DType::UINT8) return pick<uint8_t>(method);
+            if (native == DType::INT8) return pick<int8_t>(method);
+            if (native == DType::UINT16) return pick<uint16_t>(method);
+            if (native == DType::INT16) return pick<int16_t>(method);
+            if (native == DType::UINT32) return pick<uint32_t>(method);
+            if (native == DType::INT32) return pick<int32_t>(method);
+            if (native == DType::UINT64) return pick<uint64_t>(method);
+            if (native == DType::INT64) return pick<int64_t>(method);
+            if (native == DType::FLOAT) return pick<float>(method);
+            if (native == DType::DOUBLE) return pick<double>(method);
+            throw std::runtime_error("Pyramid can only downsample integer and floating point datasets.");
+        }
+        //make each tile of to from the 2x2 tiles of from under it
+        static void downsample(Dataset& from, Dataset& to, const DType& native, Downsample method, hsize_t tile, size_t nthreads) {
+            std::vector<hsize_t> in_extent = from.space().extent(), out_extent = to.space().extent();
+            const hsize_t cols = (out_extent[1] + tile - 1) / tile, ntiles = cols * ((out_extent[0] + tile - 1) / tile);
+            const reducer reduce = pick(native, method);
+            const size_t item_nbytes = native.size();
+            std::atomic<hsize_t> next(0);
+            std::atomic<bool> failed(false);
+            std::exception_ptr error;
+            auto work = [&]() {
+                ErrorHandler::init_thread();
+                try {
+                    aligned_vector<char> in(size_t(4 * tile * tile) * item_nbytes), out(size_t(tile * tile) * item_nbytes);
+                    for (hsize_t t = next++; t < ntiles && !failed; t = next++) {
+                        std::vector<hsize_t> out_offset = { t / cols * tile, t % cols * tile }, out_shape(2), in_offset(2), in_shape(2);
+                        for (size_t d = 0; d < 2; ++d) {
+                            out_shape[d] = std::min(tile, out_extent[d] - out_offset[d]);
+                            in_offset[d] = 2 * out_offset[d];
+                            in_shape[d] = std::min(2 * out_shape[d], in_extent[d] - in_offset[d]);
+                        }
+                        {
+                            auto lock = hdf5_lock();
+                            from.read(in.data(), native, DSpace(in_shape), in_offset);
+                        }
+                        reduce(in.data(), in_shape[0], in_shape[1], out.data(), out_shape[0], out_shape[1]);
+                        auto lock = hdf5_lock();
+                        to.write(out.data(), native, DSpace(out_shape), out_offset);
+                    }
+                }
+                catch (...) {
+                    if (!failed.exchange(true))
+                        error = std::current_exception();
+                }
+            };
+            if (nthreads == 0)
+                nthreads = std::max(1u, std::thread::hardware_concurrency());
+            nthreads = size_t(std::min<hsize_t>(nthreads, ntiles));
+            std::vector<std::thread> workers;
+            for (size_t i = 1; i < nthreads; ++i)
+                workers.emplace_back(work);
+            work();
+            for (auto& w : workers)
+                w.join();
+            if (error)
+                std::rethrow_exception(error);
+        }
+    public:
+        Pyramid() {}
+        ///open the levels of a pyramid in g, a group made by Group::createPyramid()
+        explicit Pyramid(const Group& g) : grp(g) {
+            for (size_t k = 0; grp.exists(std::to_string(k)); ++k) {
+                levels.push_back(grp.dataset(std::to_string(k)));
+                extents.push_back(levels.back().space().extent());
+            }
+            if (levels.empty())
+                throw std::runtime_error("Group has no pyramid levels.");
+        }
+        ///the number of levels, including the source
+        size_t size() const {
+            return levels.size();
+        }
+        Dataset& level(size_t k) {
+            return levels.at(k);
+        }
+        const std::vector<hsize_t>& extent(size_t k) const {
+            return extents.at(k);
+        }
+        ///the coarsest level at which region, of level 0, still covers at least view items in each dimension
+        size_t level_for(const std::vector<hsize_t>& region, const std::vector<hsize_t>& view) const {
+            if (region.size() != 2 || view.size() != 2)
+                throw std::runtime_error("Pyramid regions and views are 2D.");
+            size_t k = 0;
+            while (k + 1 < levels.size()
+                && (region[0] + (hsize_t(1) << (k + 1)) - 1) >> (k + 1) >= view[0]
+                && (region[1] + (hsize_t(1) << (k + 1)) - 1) >> (k + 1) >= view[1])
+                ++k;
+            return k;
+        }
+        ///where the region of level 0 at offset lies in level, clipped to its extent
+        Tile tile(size_t level, const std::vector<hsize_t>& offset, const std::vector<hsize_t>& region) const {
+            if (offset.size() != 2 || region.size() != 2)
+                throw std::runtime_error("Pyramid regions and views are 2D.");
+            const std::vector<hsize_t>& extent = extents.at(level);
+            Tile t = { level, std::vector<hsize_t>(2), std::vector<hsize_t>(2) };
+            for (size_t d = 0; d < 2; ++d) {
+                t.offset[d] = std::min(offset[d] >> level, extent[d]);
+                hsize_t end = std::min((offset[d] + region[d] + (hsize_t(1) << level) - 1) >> level, extent[d]);
+                t.shape[d] = end - t.offset[d];
+            }
+            return t;
+        }
+        ///where the region of level 0 at offset lies in the level to view it at: tile(level_for(region, view), offset, region)
+        Tile tile(const std::vector<hsize_t>& offset, const std::vector<hsize_t>& region, const std::vector<hsize_t>& view) const {
+            return tile(level_for(region, view), offset, region);
+        }
+        ///read a tile into buffer, which holds t.shape items
+        template<typename data_t>
+        void read(const Tile& t, data_t& buffer) {
+            levels.at(t.level).read(buffer, Hyperslab(t.offset, t.shape));
+        }
+        ///read a tile, with allocate
+        template<typename data_t>
+        typename adapt<data_t>::allocate_return read(const Tile& t) {
+            return levels.at(t.level).read<data_t>(t.shape, t.offset);
+        }
+    };
+
+    inline Pyramid Group::createPyramid(const std::string &name, const std::string &source, Downsample method, hsize_t tile, size_t nthreads) {
+        Dataset src = dataset(source);
+        std::vector<hsize_t> extent = src.space().extent();
+        if (extent.size() != 2)
+            throw std::runtime_error("Pyramid needs a 2D dataset.");
+        if (tile == 0)
+            throw std::runtime_error("Pyramid tiles can't be empty.");
+        DType type = src.dtype(), native = type.native();
+        DProps props = src.props();
+        if (props.is_virtual())
+            props = DProps();
+        Group grp = createGroup(name);
+        grp.createHardLink("0", src);
+        Dataset from = src;
+        for (size_t k = 1; extent[0] > tile || extent[1] > tile; ++k) {
+            extent = { (extent[0] + 1) / 2, (extent[1] + 1) / 2 };
+            props.chunked({ std::min(tile, extent[0]), std::min(tile, extent[1]) });
+            Dataset to = grp.createDataset(std::to_string(k), type, DSpace(extent), props);
+            Pyramid::downsample(from, to, native, method, tile, nthreads);
+            from = to;
+        }
+        return Pyramid(grp);
+    }
+    inline Pyramid Group::pyramid(const std::string &name) {
+        return Pyramid(group(name));
+    }
+
+    /** \brief Columns of equal length, appended to in lockstep.
+    *
+    * Each column is an unlimited 1D dataset in the table's group, which lists them, in order, in its H5TL_columns
+    * attribute. The table keeps the row count of all its columns, so append_rows() extends each to the same new length
+    * without asking HDF5 for their extents, then writes each. A column left longer than the others -- by an append that
+    * failed part way -- is cut back by the next append. read_rows() reads all its columns with one H5Dread_multi where
+    * HDF5 has it (1.14 and later), and one after another before that. Buffers are laid out as H5TL::memory_space()
+    * says, as for Dataset. A Table is not safe to append to from several threads at once.
+    */
+    class Table {
+        friend class Group;
+    protected:
+        struct col {
+            std::string name;
+            Dataset dset;
+            DType type; //the native type of its items
+        };
+        Group grp;
+        std::vector<col> cols;
+        hsize_t nrows;
+
+        size_t find(const std::string& name) const {
+            for (size_t i = 0; i < cols.size(); ++i)
+                if (cols[i].name == name) return i;
+            throw std::runtime_error("Table has no column " + name + ".");
+        }
+        std::vector<size_t> find(const std::vector<std::string>& names) const {
+            std::vector<size_t> which(names.size());
+            for (size_t k = 0; k < names.size(); ++k)
+                which[k] = find(names[k]);
+            if (names.empty()) {
+                which.resize(cols.size());
+                std::iota(which.begin(), which.end(), size_t(0));
+            }
+            return which;
+        }
+        //set every column's extent to nrows + n
+        void extend(hsize_t n) {
+            std::vector<hsize_t> extent(1, nrows + n);
+            for (col& c : cols)
+                c.dset.resize(extent);
+        }
+        void write_column(size_t i, const void* buffer, const DType& type, hsize_t n) {
+            std::vector<hsize_t> offset(1, nrows), shape(1, n);
+            cols[i].dset.write(buffer, type, DSpace(shape), Hyperslab(offset, shape));
+        }
+        //write buffer, laid out as H5TL::memory_space() says, like Dataset::write(buffer, type, selection)
+        template<typename data_t>
+        void write_column(size_t i, const data_t& buffer, hsize_t n) {
+            std::vector<hsize_t> offset(1, nrows), shape(1, n);
+            cols[i].dset.write(buffer, H5TL::dtype(buffer), Hyperslab(offset, shape));
+        }
+        //read into each buffer through its memory space, or through memory of end - begin items if memories is null
+        void read_columns(hsize_t begin, hsize_t end, const std::vector<size_t>& which, void* const* buffers, const DType* const* types,
+            const DSpace* const* memories = nullptr) {
+            if (begin > end || end > nrows)
+                throw std::runtime_error("Cannot read rows " + std::to_string(begin) + " to " + std::to_string(end) + " of a table of " + std::to_string(nrows) + ".");
+            if (begin == end || which.empty())
+                return;
+            std::vector<hsize_t> offset(1, begin), shape(1, end - begin);
+            DSpace rows(shape);
+            auto memory = [&](size_t k) -> const DSpace& { return memories ? *memories[k] : rows; };
+#if H5_VERSION_GE(1, 14, 0)
+            std::vector<DSpace> files;
+            std::vector<hid_t> dsets, mem_types, mem_spaces, file_spaces;
+            std::vector<void*> bufs(buffers, buffers + which.size());
+            for (size_t k = 0; k < which.size(); ++k) {
+                files.push_back(cols[which[k]].dset.space());
+                files.back().select(Hyperslab(offset, shape));
+                dsets.push_back(cols[which[k]].dset);
+                mem_types.push_back(*types[k]);
+                mem_spaces.push_back(memory(k));
+                file_spaces.push_back(files.back());
+            }
+            check(H5TL_PROFILED("H5Dread_multi", dsets[0], 0, H5Dread_multi(dsets.size(), dsets.data(), mem_types.data(),
+                mem_spaces.data(), file_spaces.data(), H5P_DEFAULT, bufs.data())));
+#else
+            //HDF5 runs one call at a time, so reading from a thread per column gains nothing, and costs the threads
+            for (size_t k = 0; k < which.size(); ++k)
+                cols[which[k]].dset.read(buffers[k], *types[k], memory(k), Hyperslab(offset, shape));
 #endif
+        }
+        template<typename data_t>
+        static hsize_t items(const data_t& buffer) {
+            std::vector<hsize_t> shape = H5TL::shape(buffer);
+            return util::product(shape.begin(), shape.end(), hsize_t(1));
+        }
+    public:
+        Table() : nrows(0) {}
+        ///open the columns of a table in g, a group made by Group::createTable()
+        explicit Table(const Group& g) : grp(g), nrows(0) {
+            Attribute a = grp.attribute("H5TL_columns");
+            DType t = a.dtype();
+            std::string names(t.size(), '\0');
+            a.read(&names[0], t);
+            std::istringstream lines(names.c_str());
+            for (std::string name; std::getline(lines, name);) {
+                col c = { name, grp.dataset(name), DType() };
+                c.type = c.dset.dtype().native();
+                cols.push_back(std::move(c));
+            }
+            if (cols.empty())
+                throw std::runtime_error("Group has no table columns.");
+            refresh();
+        }
+        ///the number of rows: the length of the shortest column
+        hsize_t rows() const {
+            return nrows;
+        }
+        std::vector<std::string> columns() const {
+            std::vector<std::string> names;
+            for (const col& c : cols)
+                names.push_back(c.name);
+            return names;
+        }
+        Dataset& column(const std::string& name) {
+            return cols[find(name)].dset;
+        }
+        ///the native type of a column's items, which append_rows() and read_rows() buffers of pointers hold
+        const DType& type(const std::string& name) const {
+            return cols[find(name)].type;
+        }
+        ///reload the row count, to see rows appended through other handles or by a SWMR writer
+        Table& refresh() {
+            hsize_t n = std::numeric_limits<hsize_t>::max();
+            for (col& c : cols) {
+                c.dset.refresh();
+                std::vector<hsize_t> extent = c.dset.space().extent();
+                n = std::min(n, extent.empty() ? 0 : extent[0]);
+            }
+            nrows = n;
+            return *this;
+        }
+        /** \brief Append n rows, from a buffer for each column holding n items of its type().
+        */
+        Table& append_rows(hsize_t n, const std::vector<const void*>& buffers) {
+            H5TL_PROFILE_SCOPE("Table::append_rows", grp);
+            if (buffers.size() != cols.size())
+                throw std::runtime_error("append_rows needs a buffer for each column.");
+            extend(n);
+            for (size_t i = 0; i < cols.size(); ++i)
+                write_column(i, buffers[i], cols[i].type, n);
+            nrows += n;
+            return *this;
+        }
+        /** \brief Append rows, from a buffer for each column, in order, all holding as many items.
+        *
+        * Items are converted from the type of each buffer to that of its column.
+        */
+        template<typename data_t, typename... more_t>
+        typename std::enable_if<!std::is_arithmetic<data_t>::value, Table&>::type
+            append_rows(const data_t& first, const more_t&... more) {
+                H5TL_PROFILE_SCOPE("Table::append_rows", grp);
+                if (1 + sizeof...(more_t) != cols.size())
+                    throw std::runtime_error("append_rows needs a buffer for each column.");
+                const hsize_t n = items(first), counts[] = { n, items(more)... };
+                for (hsize_t c : counts)
+                    if (c != n) throw std::runtime_error("append_rows needs the same number of items for each column.");
+                extend(n);
+                size_t i = 0;
+                int in_order[] = { (write_column(i++, first, n), 0), (write_column(i++, more, n), 0)... };
+                (void)in_order;
+                nrows += n;
+                return *this;
+        }
+        /** \brief Read rows [begin, end) of the named columns, or all of them if names is empty.
+        * \param buffers One for each column read, holding end - begin items of its type().
+        */
+        void read_rows(hsize_t begin, hsize_t end, const std::vector<std::string>& names, const std::vector<void*>& buffers) {
+            H5TL_PROFILE_SCOPE("Table::read_rows", grp);
+            std::vector<size_t> which = find(names);
+            if (buffers.size() != which.size())
+                throw std::runtime_error("read_rows needs a buffer for each column it reads.");
+            std::vector<const DType*> types(which.size());
+            for (size_t k = 0; k < which.size(); ++k)
+                types[k] = &cols[which[k]].type;
+            read_columns(begin, end, which, buffers.data(), types.data());
+        }
+        /** \brief Read rows [begin, end) of the named columns, or all of them if names is empty.
+        *
+        * Each buffer, one for each column read, holds end - begin items, converted to its own type.
+        */
+        template<typename data_t, typename... more_t>
+        void read_rows(hsize_t begin, hsize_t end, const std::vector<std::string>& names, data_t& first, more_t&... more) {
+            H5TL_PROFILE_SCOPE("Table::read_rows", grp);
+            std::vector<size_t> which = find(names);
+            if (1 + sizeof...(more_t) != which.size())
+                throw std::runtime_error("read_rows needs a buffer for each column it reads.");
+            const hsize_t counts[] = { items(first), items(more)... };
+            for (hsize_t c : counts)
+                if (c != end - begin) throw std::runtime_error("read_rows needs buffers of end - begin items.");
+            //each buffer is read in place as H5TL::memory_space() says, or into a C-ordered copy that is scattered to it
+            void* memory[] = { H5TL::data(first), H5TL::data(more)... };
+            DType types[] = { H5TL::dtype(first).share(), H5TL::dtype(more).share()... };
+            detail::strided_layout layouts[] = { detail::memory_layout(first), detail::memory_layout(more)... };
+            aligned_vector<char> staged[1 + sizeof...(more_t)];
+            void* buffers[1 + sizeof...(more_t)];
+            const DType* type_ptrs[1 + sizeof...(more_t)];
+            const DSpace* spaces[1 + sizeof...(more_t)];
+            for (size_t k = 0; k < which.size(); ++k) {
+                type_ptrs[k] = &types[k];
+                spaces[k] = &layouts[k].space;
+                buffers[k] = memory[k];
+                if (layouts[k].staged) {
+                    staged[k].resize(size_t(end - begin) * types[k].size());
+                    buffers[k] = staged[k].data();
+                }
+            }
+            read_columns(begin, end, which, buffers, type_ptrs, spaces);
+            for (size_t k = 0; k < which.size(); ++k)
+                if (layouts[k].staged)
+                    detail::stage(layouts[k], types[k].size(), staged[k].data(), (char*)memory[k], true);
+        }
+        ///read rows [begin, end) of one column, with allocate
+        template<typename data_t>
+        typename adapt<data_t>::allocate_return read(const std::string& name, hsize_t begin, hsize_t end) {
+            if (begin > end || end > nrows)
+                throw std::runtime_error("Cannot read rows " + std::to_string(begin) + " to " + std::to_string(end) + " of a table of " + std::to_string(nrows) + ".");
+            return cols[find(name)].dset.read<data_t>({ end - begin }, { begin });
+        }
+    };
+
+    inline Table Group::createTable(const std::string &name, const std::vector<std::pair<std::string, DType>> &columns, const DProps& props) {
+        if (columns.empty())
+            throw std::runtime_error("A table needs at least one column.");
+        std::string names;
+        for (const auto& c : columns) {
+            if (c.first.empty() || c.first.find('\n') != std::string::npos)
+                throw std::runtime_error("Table column names must be non-empty, without line breaks.");
+            names += c.first + "\n";
+        }
+        Group grp = createGroup(name);
+        for (const auto& c : columns)
+            grp.createDataset(c.first, c.second, DSpace({ 0 }, { DSpace::UNLIMITED }), props);
+        grp.writeAttribute("H5TL_columns", names);
+        return Table(grp);
+    }
+    inline Table Group::table(const std::string &name) {
+        return Table(group(name));
+    }
+
+    /** \brief Rows in time order: a Table whose first column, "time", never decreases, with a sparse index of it.
+    *
+    * The index holds the timestamps of rows 0, stride, 2 stride, ... in memory, and in the group's dataset time_index,
+    * whose H5TL_stride attribute is the stride. To find the first row at or after a time, the index is searched, then
+    * the one block of stride timestamps it points to, so read_range() reads two blocks of the time column and then each
+    * column's rows with one hyperslab read, rather than scanning the time column. An index left short -- by an append
+    * that failed part way -- is completed from the time column when the series is opened.
+    */
+    template<typename T = double>
+    class TimeSeries {
+        friend class Group;
+    protected:
+        Table tbl;
+        Dataset time, index_dset;
+        std::vector<T> index;
+        hsize_t stride, persisted; //index entries up to persisted are in index_dset
+        T last;
+
+        static const DType& time_type() {
+            return H5TL::dtype(T());
+        }
+        void read_times(T* buffer, hsize_t begin, hsize_t n) {
+            std::vector<hsize_t> offset(1, begin), shape(1, n);
+            time.read(buffer, time_type(), DSpace(shape), Hyperslab(offset, shape));
+        }
+        //fit the index to the rows, reading the timestamps it's missing from the time column
+        void complete_index() {
+            const hsize_t want = (tbl.rows() + stride - 1) / stride, have = std::min<hsize_t>(index.size(), want);
+            index.resize(size_t(want));
+            persisted = std::min(persisted, want);
+            if (have < want) {
+                std::vector<hsize_t> start(1, have * stride), count(1, want - have), step(1, stride), block(1, 1);
+                time.read(&index[size_t(have)], time_type(), DSpace(count), Hyperslab(start, count, step, block));
+            }
+            if (tbl.rows() > 0)
+                read_times(&last, tbl.rows() - 1, 1);
+        }
+        void check_order(const T* times, hsize_t n) const {
+            for (hsize_t i = 0; i < n; ++i)
+                if (i > 0 ? times[i] < times[i - 1] : (tbl.rows() > 0 && times[0] < last))
+                    throw std::runtime_error("TimeSeries times must not decrease.");
+        }
+        //add the timestamps of the rows appended from row `from` to the index, and store them
+        void extend_index(const T* times, hsize_t from, hsize_t n) {
+            for (hsize_t r = (from + stride - 1) / stride * stride; r < from + n; r += stride)
+                index.push_back(times[r - from]);
+            if (n > 0)
+                last = times[n - 1];
+            if (persisted < index.size()) {
+                std::vector<hsize_t> offset(1, persisted);
+                index_dset.append(&index[size_t(persisted)], time_type(), DSpace({ hsize_t(index.size() - persisted) }), offset);
+                persisted = index.size();
+            }
+        }
+    public:
+        TimeSeries() : stride(0), persisted(0), last() {}
+        ///open a time series in g, a group made by Group::createTimeSeries()
+        explicit TimeSeries(const Group& g) : tbl(g), persisted(0), last() {
+            Group grp(g);
+            time = tbl.column("time");
+            if (!(tbl.type("time") == time_type()))
+                throw std::runtime_error("The time column's type doesn't match the TimeSeries'.");
+            index_dset = grp.dataset("time_index");
+            uint64_t s = 0;
+            index_dset.readAttribute("H5TL_stride", s);
+            stride = std::max<hsize_t>(s, 1);
+            //read what's stored of the index, then complete it
+            std::vector<hsize_t> extent = index_dset.space().extent();
+            hsize_t n = std::min(extent.at(0), (tbl.rows() + stride - 1) / stride);
+            index.resize(size_t(n));
+            if (n > 0) {
+                std::vector<hsize_t> offset(1, 0), shape(1, n);
+                index_dset.read(index.data(), time_type(), DSpace(shape), Hyperslab(offset, shape));
+            }
+            persisted = n;
+            complete_index();
+        }
+        hsize_t rows() const {
+            return tbl.rows();
+        }
+        ///the columns, the first being "time"
+        Table& table() {
+            return tbl;
+        }
+        ///the number of rows between the timestamps in the index
+        hsize_t index_stride() const {
+            return stride;
+        }
+        ///reload the row count and index, to see rows appended through other handles or by a SWMR writer
+        TimeSeries& refresh() {
+            tbl.refresh();
+            index_dset.refresh();
+            complete_index();
+            return *this;
+        }
+        /** \brief Append n rows: their times, which must not decrease, and a buffer for each value column holding n items
+        * of its Table::type().
+        */
+        TimeSeries& append(hsize_t n, const T* times, const std::vector<const void*>& values) {
+            H5TL_PROFILE_SCOPE("TimeSeries::append", time);
+            check_order(times, n);
+            std::vector<const void*> buffers(1, times);
+            buffers.insert(buffers.end(), values.begin(), values.end());
+            const hsize_t from = tbl.rows();
+            tbl.append_rows(n, buffers);
+            extend_index(times, from, n);
+            return *this;
+        }
+        /** \brief Append rows: their times, which must not decrease, and a buffer for each value column, in order, all
+        * holding as many items.
+        */
+        template<typename... values_t>
+        TimeSeries& append(const std::vector<T>& times, const values_t&... values) {
+            H5TL_PROFILE_SCOPE("TimeSeries::append", time);
+            check_order(times.data(), times.size());
+            const hsize_t from = tbl.rows();
+            tbl.append_rows(times, values...);
+            extend_index(times.data(), from, times.size());
+            return *this;
+        }
+        ///the first row whose time is at or after t, or rows() if there is none
+        hsize_t locate(const T& t) {
+            const hsize_t k = hsize_t(std::lower_bound(index.begin(), index.end(), t) - index.begin());
+            if (k == 0)
+                return 0;
+            //row (k - 1) stride is before t, and row k stride, if there is one, is not
+            const hsize_t lo = (k - 1) * stride + 1, hi = std::min(k * stride, tbl.rows());
+            if (lo >= hi)
+                return hi;
+            std::vector<T> block(size_t(hi - lo));
+            read_times(block.data(), lo, hi - lo);
+            return lo + hsize_t(std::lower_bound(block.begin(), block.end(), t) - block.begin());
+        }
+        ///the rows [first, second) whose times are at or after t0 and before t1
+        std::pair<hsize_t, hsize_t> rows_between(const T& t0, const T& t1) {
+            hsize_t begin = locate(t0);
+            return std::make_pair(begin, t1 > t0 ? std::max(begin, locate(t1)) : begin);
+        }
+        /** \brief Read the named columns of the rows whose times are at or after t0 and before t1.
+        *
+        * Each buffer, one for each column named, is allocated to hold the rows, like Dataset::read<data_t>().
+        * \returns The rows read, [first, second).
+        */
+        template<typename data_t, typename... more_t>
+        std::pair<hsize_t, hsize_t> read_range(const T& t0, const T& t1, const std::vector<std::string>& names, data_t& first, more_t&... more) {
+            H5TL_PROFILE_SCOPE("TimeSeries::read_range", time);
+            std::pair<hsize_t, hsize_t> r = rows_between(t0, t1);
+            const std::vector<hsize_t> shape(1, r.second - r.first);
+            std::vector<std::string> which = names.empty() ? tbl.columns() : names;
+            if (1 + sizeof...(more_t) != which.size())
+                throw std::runtime_error("read_range needs a buffer for each column it reads.");
+            size_t i = 0;
+            first = H5TL::allocate<data_t>(shape, tbl.type(which[i++]));
+            int in_order[] = { 0, (more = H5TL::allocate<more_t>(shape, tbl.type(which[i++])), 0)... };
+            (void)in_order;
+            tbl.read_rows(r.first, r.second, which, first, more...);
+            return r;
+        }
+        ///read one column of the rows whose times are at or after t0 and before t1, with allocate
+        template<typename data_t>
+        typename adapt<data_t>::allocate_return read_range(const T& t0, const T& t1, const std::string& name) {
+            H5TL_PROFILE_SCOPE("TimeSeries::read_range", time);
+            std::pair<hsize_t, hsize_t> r = rows_between(t0, t1);
+            return tbl.read<data_t>(name, r.first, r.second);
+        }
+    };
+
+    template<typename T>
+    inline TimeSeries<T> Group::createTimeSeries(const std::string &name, const std::vector<std::pair<std::string, DType>> &values, const DProps& props, hsize_t stride) {
+        std::vector<std::pair<std::string, DType>> columns;
+        columns.emplace_back("time", TimeSeries<T>::time_type());
+        columns.insert(columns.end(), values.begin(), values.end());
+        Table table = createTable(name, columns, props);
+        if (stride == 0) {
+            std::vector<hsize_t> chunk = table.column("time").props().chunk();
+            stride = chunk.empty() ? 1024 : std::min<hsize_t>(chunk[0], 1024);
+        }
+        Group grp = group(name);
+        grp.createDataset("time_index", TimeSeries<T>::time_type(), DSpace({ 0 }, { DSpace::UNLIMITED })).writeAttribute("H5TL_stride", uint64_t(stride));
+        return TimeSeries<T>(grp);
+    }
+    template<typename T>
+    inline TimeSeries<T> Group::timeSeries(const std::string &name) {
+        return TimeSeries<T>(group(name));
+    }
+}
 
 #ifdef H5TL_BLITZ_ADAPT
 //BLITZ++ shape, rank, dtype, data adapters
@@ -1665,6 +5612,14 @@ namespace H5TL {
         static const_data_return data(const blitz::Array<T, N>& d) {
             return (const_data_return)d.data();
         }
+        //slices, transposes and column-major (fortranArray) arrays are read and written in place
+        static std::vector<hssize_t> strides(const blitz::Array<T, N>& d) {
+            auto s = d.stride();
+            std::vector<hssize_t> tmp(N);
+            for (int k = 0; k < N; ++k)
+                tmp[k] = hssize_t(s[k]);
+            return tmp;
+        }
         static allocate_return allocate(const std::vector<hsize_t>& shape, const DType&) {
             if (shape.size() > N)
                 throw std::runtime_error("Cannot allocate blitz::Array<T,N> with higher dimensionality shape = {" + util::join(", ", shape.begin(), shape.end()) + "}.");
@@ -1680,7 +5635,6 @@ namespace H5TL {
 }
 #endif
 
-//#define H5TL_OCV_ADAPT
 #ifdef H5TL_OCV_ADAPT
 //OpenCV shape, rank, dtype, data adapters
 #include "opencv2/opencv.hpp"
@@ -1752,6 +5706,15 @@ namespace H5TL {
         static const_data_return data(const cv::Mat& d) {
             return d.data;
         }
+        //regions of interest, whose rows are further apart than their width, are read and written in place
+        static std::vector<hssize_t> strides(const cv::Mat& d) {
+            std::vector<hssize_t> tmp(rank(d));
+            for (int k = 0; k < d.dims; ++k)
+                tmp[k] = hssize_t(d.step[k] / d.elemSize1());
+            if (d.channels() > 1)
+                tmp[d.dims] = 1;
+            return tmp;
+        }
         static allocate_return allocate(const std::vector<hsize_t>& shape, const DType& dt) {
             //allocate and then fill using std::transform with explicit cast -- avoids conversion warnings blowing up the console
             std::vector<int> sz(shape.size());
@@ -1777,6 +5740,81 @@ namespace H5TL {
 }
 #endif
 
+#ifdef H5TL_EIGEN_ADAPT
+//Eigen shape, rank, dtype, data adapters
+#include <Eigen/Core>
+
+namespace H5TL {
+    namespace detail {
+        //Eigen expressions whose coefficients are in memory: Matrix, Array, and Maps, Blocks, Refs and Transposes of them
+        template<typename T, bool = std::is_base_of<Eigen::EigenBase<T>, T>::value>
+        struct eigen_direct : std::false_type {};
+        template<typename T>
+        struct eigen_direct<T, true> : std::integral_constant<bool, (unsigned(T::Flags) & Eigen::DirectAccessBit) != 0> {};
+    }
+
+    //vectors are rank 1, everything else rank 2. Row-major matrices, and blocks of them, are read and written in place;
+    //column-major ones are transposed through a copy. Reads with allocate return the expression's plain Matrix or Array
+    template<typename T>
+    struct adapt<T, typename std::enable_if<detail::eigen_direct<T>::value>::type> {
+        typedef typename std::remove_const<typename T::Scalar>::type data_t;
+        typedef typename bool_to_int<data_t>::type data_nbt;
+        typedef const DType& dtype_return;
+        typedef data_nbt* data_return;
+        typedef const data_nbt* const_data_return;
+        typedef typename T::PlainObject allocate_return;
+
+        static size_t rank(const T&) {
+            return T::IsVectorAtCompileTime ? 1 : 2;
+        }
+        static std::vector<hsize_t> shape(const T& d) {
+            if (T::IsVectorAtCompileTime)
+                return std::vector<hsize_t>(1, hsize_t(d.size()));
+            return { hsize_t(d.rows()), hsize_t(d.cols()) };
+        }
+        static std::vector<hssize_t> strides(const T& d) {
+            if (T::IsVectorAtCompileTime)
+                return std::vector<hssize_t>(1, hssize_t(d.innerStride()));
+            if (T::IsRowMajor)
+                return { hssize_t(d.outerStride()), hssize_t(d.innerStride()) };
+            return { hssize_t(d.innerStride()), hssize_t(d.outerStride()) };
+        }
+        static dtype_return dtype(const T&) {
+            return H5TL::pdtype(data_nbt());
+        }
+        static data_return data(T& d) {
+            return (data_return)d.data();
+        }
+        static const_data_return data(const T& d) {
+            return (const_data_return)d.data();
+        }
+        static allocate_return allocate(const std::vector<hsize_t>& shape, const DType&) {
+            typedef allocate_return M;
+            if (shape.size() > 2 && util::product(shape.begin(), shape.end() - 2, hsize_t(1)) > 1)
+                throw std::runtime_error("Cannot allocate an Eigen matrix with rank > 2, shape = {" + util::join(", ", shape.begin(), shape.end()) + "}.");
+            //a rank 1 dataset becomes a column, unless M is a row vector
+            Eigen::Index rows = 1, cols = 1;
+            if (M::IsVectorAtCompileTime) {
+                Eigen::Index n = Eigen::Index(util::product(shape.begin(), shape.end(), hsize_t(1)));
+                (M::RowsAtCompileTime == 1 ? cols : rows) = n;
+            }
+            else if (shape.size() == 1) {
+                rows = Eigen::Index(shape[0]);
+            }
+            else if (shape.size() >= 2) {
+                rows = Eigen::Index(shape[shape.size() - 2]);
+                cols = Eigen::Index(shape[shape.size() - 1]);
+            }
+            if ((M::RowsAtCompileTime != Eigen::Dynamic && rows != M::RowsAtCompileTime) || (M::ColsAtCompileTime != Eigen::Dynamic && cols != M::ColsAtCompileTime))
+                throw std::runtime_error("Cannot allocate a fixed size Eigen matrix with shape = {" + util::join(", ", shape.begin(), shape.end()) + "}.");
+            M tmp;
+            tmp.resize(rows, cols);
+            return tmp;
+        }
+    };
+}
+#endif
+
 #ifdef H5TL_QT_ADAPT
 #include <QVector>
 
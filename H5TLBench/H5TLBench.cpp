@@ -0,0 +1,885 @@
+/**********
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samuel Bear Powell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+\**********/
+
+// H5TLBench.cpp : Timing loops over the hot paths of H5TL.
+// Output is CSV: benchmark,iterations,seconds,ns_per_op,value
+// value is blank except where a benchmark measures something besides time: MB/s for throughput (adapt_, append_, read_, write_,
+// stitch_copy, and the bitmask, strided, eigen, pyramid and table groups), and compression ratio for compress_ and lossy_ reads.
+// Usage: H5TLBench [group...] runs only the named groups (see main), or all of them.
+
+#include "../H5TL/H5TL.hpp"
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include <future>
+#include <functional>
+#include <cmath>
+#include <algorithm>
+#include <array>
+#include <memory>
+using namespace std;
+
+void report(const string& name, size_t iterations, double s, const string& value = "") {
+	cout << name << "," << iterations << "," << s << "," << (s*1e9 / double(iterations)) << "," << value << endl;
+}
+
+//run f(i) for i in [0, iterations) and print one CSV line with the timing
+template<typename F>
+void bench(const string& name, size_t iterations, F f) {
+	auto t0 = chrono::steady_clock::now();
+	for (size_t i = 0; i < iterations; ++i)
+		f(i);
+	report(name, iterations, chrono::duration<double>(chrono::steady_clock::now() - t0).count());
+}
+
+//like bench, but also reports throughput, for f moving nbytes each iteration
+template<typename F>
+void bench_bytes(const string& name, size_t iterations, size_t nbytes, F f) {
+	auto t0 = chrono::steady_clock::now();
+	for (size_t i = 0; i < iterations; ++i)
+		f(i);
+	double s = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+	ostringstream mb_per_s;
+	mb_per_s << double(nbytes)*double(iterations) / s / 1e6;
+	report(name, iterations, s, mb_per_s.str());
+}
+
+//tight loops over attribute and dataset handles
+void bench_handles(H5TL::File& f) {
+	vector<int> v(16);
+	iota(v.begin(), v.end(), 0);
+	H5TL::Dataset ds = f.write("handles/v", v);
+	ds.writeAttribute("scale", 1.0);
+
+	bench("attribute_write_read", 20000, [&](size_t i) {
+		H5TL::Attribute a = ds.attribute("scale");
+		a.write(double(i));
+		double x;
+		a.read(x);
+	});
+	bench("dataset_read_small", 20000, [&](size_t) {
+		ds.read(v);
+	});
+	bench("dataset_write_small", 20000, [&](size_t) {
+		ds.write(v);
+	});
+	bench("dataset_open_close", 20000, [&](size_t) {
+		H5TL::Dataset d = f.dataset("handles/v");
+	});
+	//convert through a base-class reference, as the library does when passing handles to the C API
+	const H5TL::Object& obj = ds;
+	volatile hid_t sink = 0;
+	bench("hid_conversion", 10000000, [&](size_t) {
+		sink = obj;
+	});
+	bench("dataset_copy", 100000, [&](size_t) {
+		H5TL::Dataset d(ds);
+	});
+	H5TL::DType dt(H5TL::DType::INT32, 4);
+	bench("dtype_copy", 100000, [&](size_t) {
+		H5TL::DType t(dt);
+	});
+	bench("dtype_share", 100000, [&](size_t) {
+		H5TL::DType t = dt.share();
+	});
+	H5TL::DProps dp = H5TL::DProps().chunked({ 16 }).deflate(1);
+	bench("create_dataset_chunked", 2000, [&](size_t i) {
+		f.createDataset("handles/c" + to_string(i), H5TL::DType::INT32, H5TL::DSpace({ 16 }), dp);
+	});
+	//probing for something that isn't there, as an exception and as a result
+	bench("probe_missing_throw", 20000, [&](size_t) {
+		try {
+			f.dataset("handles/missing");
+		}
+		catch (H5TL::h5tl_error&) {}
+	});
+	bench("probe_missing_try", 20000, [&](size_t) {
+		auto d = f.try_dataset("handles/missing");
+	});
+	bench("exists_deep_path", 20000, [&](size_t) {
+		f.exists("handles/v");
+	});
+	bench("vector_dataset_push_back", 100, [&](size_t) {
+		vector<H5TL::Dataset> dsets;
+		for (int j = 0; j < 256; ++j)
+			dsets.push_back(f.dataset("handles/v"));
+	});
+}
+
+//write then read a dataset holding x, through its adapter, iterations times each
+template<typename T>
+void bench_adapter(H5TL::File& f, const string& name, T& x, size_t iterations) {
+	H5TL::Dataset ds = f.write("adapt/" + name, x);
+	size_t nbytes = size_t(H5TL::space(x).count()) * H5TL::dtype(x).size();
+	bench_bytes("adapt_write_" + name, iterations, nbytes, [&](size_t) {
+		ds.write(x);
+	});
+	bench_bytes("adapt_read_" + name, iterations, nbytes, [&](size_t) {
+		ds.read(x);
+	});
+}
+
+//write and read throughput of each standard adapter, small and large
+void bench_adapters(H5TL::File& f) {
+	int i32 = 1;
+	bench_adapter(f, "scalar_int", i32, 20000);
+	double f64 = 1.0;
+	bench_adapter(f, "scalar_double", f64, 20000);
+	string str(64, 'x');
+	bench_adapter(f, "string_64", str, 20000);
+	double carray[64] = { 0 };
+	bench_adapter(f, "c_array_double_64", carray, 20000);
+	array<double, 64> stdarray = {{ 0 }};
+	bench_adapter(f, "array_double_64", stdarray, 20000);
+	vector<double> small(64, 1.0);
+	bench_adapter(f, "vector_double_64", small, 20000);
+	vector<float> large(1 << 22, 1.0f);
+	bench_adapter(f, "vector_float_4m", large, 20);
+	vector<uint8_t> bytes(1 << 24, 1);
+	bench_adapter(f, "vector_uint8_16m", bytes, 20);
+	array<array<double, 4>, 4> matrix = {};
+	bench_adapter(f, "array_array_double_4x4", matrix, 20000);
+	vector<array<float, 3>> points(1 << 20, array<float, 3>{ { 1.0f, 2.0f, 3.0f } });
+	bench_adapter(f, "vector_array_float_1mx3", points, 20);
+	//what writing points took before nested arrays were adapted: flattening them into a vector<float>
+	vector<float> flat(points.size() * 3);
+	H5TL::Dataset ds = f.dataset("adapt/vector_array_float_1mx3");
+	bench_bytes("adapt_write_vector_array_float_1mx3_flattened", 20, flat.size() * sizeof(float), [&](size_t) {
+		for (size_t i = 0; i < points.size(); ++i)
+			std::copy(points[i].begin(), points[i].end(), flat.begin() + 3 * i);
+		ds.write(flat.data(), H5TL::DType::FLOAT, H5TL::DSpace({ hsize_t(points.size()), 3 }));
+	});
+}
+
+//appending one row at a time to an unlimited dataset, by row length; value is MB/s
+void bench_append(H5TL::File& f) {
+	for (hsize_t row : { 1, 16, 256, 4096 }) {
+		const size_t nrows = size_t(std::max<hsize_t>(200, (1 << 22) / (row * 4 * 64)) );
+		hsize_t dims[] = { 0, row }, maxdims[] = { H5TL::DSpace::UNL, row };
+		H5TL::Dataset ds = f.createDataset("append/row" + to_string(row), H5TL::DType::FLOAT, H5TL::DSpace(dims, maxdims));
+		vector<float> buffer(row, 1.0f);
+		bench_bytes("append_row_" + to_string(row), nrows, row * 4, [&](size_t) {
+			ds.append(buffer.data(), H5TL::DType::FLOAT, H5TL::DSpace({ 1, row }));
+		});
+	}
+}
+
+//latency of reading small to large hyperslabs at random positions of an uncompressed chunked dataset
+void bench_hyperslab(H5TL::File& f) {
+	const hsize_t rows = 4096, cols = 1024;
+	{
+		vector<float> data(rows*cols);
+		iota(data.begin(), data.end(), 0.0f);
+		f.write("hyperslab/data", data, H5TL::DSpace({ rows, cols }), H5TL::DProps().chunked({ 64, 64 }));
+	}
+	H5TL::Dataset ds = f.dataset("hyperslab/data");
+	for (hsize_t side : { 1, 16, 256 }) {
+		vector<float> buffer(side*side);
+		size_t seed = 12345;
+		bench("hyperslab_random_read_" + to_string(side) + "x" + to_string(side), side < 256 ? 20000 : 500, [&](size_t) {
+			seed = seed * 1103515245 + 12345;
+			hsize_t r = (seed >> 8) % (rows - side + 1), k = (seed >> 20) % (cols - side + 1);
+			ds.read(buffer, H5TL::DSpace({ side, side }), { r, k });
+		});
+	}
+}
+
+//creating datasets and attributes, and checking deep paths
+void bench_metadata(H5TL::File& f) {
+	bench("create_dataset_contiguous", 2000, [&](size_t i) {
+		f.createDataset("metadata/d" + to_string(i), H5TL::DType::DOUBLE, H5TL::DSpace({ 16 }));
+	});
+	bench("create_dataset_chunked_deflate", 2000, [&](size_t i) {
+		hsize_t dims[] = { 0 }, maxdims[] = { H5TL::DSpace::UNL };
+		f.createDataset("metadata/c" + to_string(i), H5TL::DType::DOUBLE, H5TL::DSpace(dims, maxdims), H5TL::DProps().chunked({ 1024 }).deflate(1));
+	});
+	H5TL::Dataset ds = f.dataset("metadata/d0");
+	bench("attribute_create", 2000, [&](size_t i) {
+		ds.writeAttribute("a" + to_string(i), double(i));
+	});
+	bench("attribute_open_read", 20000, [&](size_t i) {
+		double x;
+		ds.attribute("a" + to_string(i % 2000)).read(x);
+	});
+	f.write("metadata/a/b/c/d/e/f/g/h/v", 1);
+	bench("valid_deep_path", 20000, [&](size_t) {
+		f.valid("metadata/a/b/c/d/e/f/g/h/v");
+	});
+	bench("valid_deep_path_missing", 20000, [&](size_t) {
+		f.valid("metadata/a/b/c/d/e/f/g/h/missing");
+	});
+	bench("valid_deep_path_missing_early", 20000, [&](size_t) {
+		f.valid("metadata/a/missing/c/d/e/f/g/h/v");
+	});
+}
+
+//aggregate throughput of many threads reading row blocks of one dataset
+void bench_reader_pool() {
+	const hsize_t rows = 16384, cols = 256, block = 8;
+	{
+		H5TL::File f("bench_pool.h5", H5TL::File::TRUNCATE);
+		vector<float> data(rows*cols);
+		iota(data.begin(), data.end(), 0.0f);
+		f.write("pool/data", data, H5TL::DSpace({ rows, cols }), H5TL::DProps().chunked({ 64, cols }).deflate(1));
+	}
+	const size_t nblocks = size_t(rows / block);
+	{
+		H5TL::File f("bench_pool.h5", H5TL::File::READ);
+		H5TL::Dataset ds = f.dataset("pool/data");
+		vector<float> buffer(block*cols);
+		bench("direct_read_block", nblocks, [&](size_t i) {
+			ds.read(buffer, H5TL::DSpace({ block, cols }), { i*block, 0 });
+		});
+	}
+	for (size_t nclients : { 1, 4, 32 }) {
+		H5TL::ReaderPool pool("bench_pool.h5", 4);
+		auto t0 = chrono::steady_clock::now();
+		vector<thread> clients;
+		for (size_t c = 0; c < nclients; ++c) {
+			clients.emplace_back([&, c] {
+				H5TL::ErrorHandler::init_thread();
+				//client c reads every nclients-th block, so concurrent requests land next to each other
+				vector<float> buffer(nblocks / nclients * block * cols);
+				vector<future<void>> pending;
+				for (size_t b = c, j = 0; b < nblocks; b += nclients, ++j)
+					pending.push_back(pool.read("pool/data", buffer.data() + j*block*cols, { block, cols }, { b*block, 0 }));
+				for (auto& p : pending)
+					p.get();
+			});
+		}
+		for (auto& t : clients)
+			t.join();
+		report("pool_read_block_c" + to_string(nclients), nblocks, chrono::duration<double>(chrono::steady_clock::now() - t0).count());
+	}
+}
+
+//replay row scans, column scans and random tiles against datasets chunked for each of them
+void bench_chunk_planner() {
+	const hsize_t rows = 4096, cols = 512, tile = 64;
+	const vector<hsize_t> shape = { rows, cols };
+	vector<float> data(rows*cols);
+	iota(data.begin(), data.end(), 0.0f);
+	vector<pair<string, vector<hsize_t>>> candidates = {
+		{ "planned_rows", H5TL::ChunkPlanner(shape, 4).compressed().rows().plan() },
+		{ "planned_columns", H5TL::ChunkPlanner(shape, 4).compressed().columns().plan() },
+		{ "planned_tiles", H5TL::ChunkPlanner(shape, 4).compressed().tiles({ tile, tile }).plan() },
+		{ "planned_mixed", H5TL::ChunkPlanner(shape, 4).compressed().rows().columns().tiles({ tile, tile }).plan() },
+		{ "size_only", H5TL::DProps().chunked(shape, 4).chunk() },
+	};
+	{
+		H5TL::File f("bench_chunks.h5", H5TL::File::TRUNCATE);
+		for (auto &c : candidates)
+			f.write("chunks/" + c.first, data, H5TL::DSpace(shape), H5TL::DProps().chunked(c.second).deflate(1));
+	}
+	H5TL::File f("bench_chunks.h5", H5TL::File::READ);
+	for (auto &c : candidates) {
+		const string suffix = "_" + c.first + "_" + to_string(c.second[0]) + "x" + to_string(c.second[1]);
+		//open a fresh handle for each pattern, so none starts with a warm chunk cache
+		{
+			H5TL::Dataset ds = f.dataset("chunks/" + c.first);
+			vector<float> buffer(cols);
+			//only the first rows: across badly shaped chunks, every row decompresses most of the dataset
+			bench("chunk_row_scan" + suffix, 128, [&](size_t i) {
+				ds.read(buffer, H5TL::DSpace({ 1, cols }), { hsize_t(i), 0 });
+			});
+		}
+		{
+			H5TL::Dataset ds = f.dataset("chunks/" + c.first);
+			vector<float> buffer(rows);
+			bench("chunk_column_scan" + suffix, 32, [&](size_t i) {
+				ds.read(buffer, H5TL::DSpace({ rows, 1 }), { 0, hsize_t(i) });
+			});
+		}
+		{
+			H5TL::Dataset ds = f.dataset("chunks/" + c.first);
+			vector<float> buffer(tile*tile);
+			//a fixed pseudo-random walk, the same for every candidate
+			size_t seed = 12345;
+			bench("chunk_random_tile" + suffix, 256, [&](size_t) {
+				seed = seed * 1103515245 + 12345;
+				hsize_t r = (seed >> 8) % (rows - tile), k = (seed >> 20) % (cols - tile);
+				ds.read(buffer, H5TL::DSpace({ tile, tile }), { r, k });
+			});
+		}
+	}
+}
+
+//write then read n items stored as file_type through props, reporting both times, and the compression ratio with the read
+void bench_filter(H5TL::File& f, const string& name, const H5TL::DProps& props, const H5TL::DType& file_type, const void* data, void* out, const H5TL::DType& mem_type, hsize_t n) {
+	auto t0 = chrono::steady_clock::now();
+	H5TL::Dataset ds = f.createDataset(name, file_type, H5TL::DSpace({ n }), props);
+	ds.write(data, mem_type, H5TL::DSpace({ n }));
+	f.flush();
+	report(name + "_write", n, chrono::duration<double>(chrono::steady_clock::now() - t0).count());
+	ostringstream ratio;
+	ratio << double(n*mem_type.size()) / double(H5Dget_storage_size(ds));
+	t0 = chrono::steady_clock::now();
+	ds.read(out, mem_type, H5TL::DSpace({ n }));
+	report(name + "_read", n, chrono::duration<double>(chrono::steady_clock::now() - t0).count(), ratio.str());
+}
+
+//write and read throughput, and compression ratio, of each filter on float and int data
+void bench_compression() {
+	const hsize_t n = 1 << 22, chunk = 1 << 16;
+	vector<float> floats(n);
+	vector<int32_t> ints(n);
+	for (size_t i = 0; i < n; ++i) {
+		//a slow signal with a little noise, and a counter with jitter
+		uint32_t noise = uint32_t(i) * 2654435761u;
+		floats[i] = float(sin(double(i)*1e-3) + 1e-3*double(noise % 1000));
+		ints[i] = int32_t(i / 3 + noise % 7);
+	}
+	struct candidate {
+		string name;
+		function<H5TL::DProps()> props;
+		H5Z_filter_t filter; //the filter needed, 0 for none
+	};
+	vector<candidate> candidates = {
+		{ "none", [] { return H5TL::DProps(); }, 0 },
+		{ "deflate1", [] { return H5TL::DProps().deflate(1); }, H5Z_FILTER_DEFLATE },
+		{ "deflate6", [] { return H5TL::DProps().deflate(6); }, H5Z_FILTER_DEFLATE },
+		{ "shuffle_deflate1", [] { return H5TL::DProps().shuffle().deflate(1); }, H5Z_FILTER_DEFLATE },
+		{ "lz4", [] { return H5TL::DProps().lz4(); }, H5TL::filters::LZ4 },
+		{ "zstd3", [] { return H5TL::DProps().zstd(3); }, H5TL::filters::ZSTD },
+		{ "shuffle_zstd3", [] { return H5TL::DProps().shuffle().zstd(3); }, H5TL::filters::ZSTD },
+		{ "blosc_lz4", [] { return H5TL::DProps().blosc(5, 1, 1); }, H5TL::filters::BLOSC },
+		{ "bitshuffle_lz4", [] { return H5TL::DProps().bitshuffle(); }, H5TL::filters::BITSHUFFLE },
+	};
+	H5TL::File f("bench_compression.h5", H5TL::File::TRUNCATE);
+	for (auto &c : candidates) {
+		if (c.filter && !H5TL::filters::available(c.filter)) {
+			cerr << "skipping compress_" << c.name << ": filter " << c.filter << " is not available" << endl;
+			continue;
+		}
+		H5TL::DProps props = c.props().chunked({ chunk });
+		vector<float> float_out(n);
+		bench_filter(f, "compress_" + c.name + "_float", props, H5TL::DType::FLOAT, floats.data(), float_out.data(), H5TL::DType::FLOAT, n);
+		vector<int32_t> int_out(n);
+		bench_filter(f, "compress_" + c.name + "_int", props, H5TL::DType::INT32, ints.data(), int_out.data(), H5TL::DType::INT32, n);
+	}
+}
+
+//scale-offset and n-bit against deflate, on float telemetry with 3 decimal digits and 12-bit samples
+void bench_lossy() {
+	const hsize_t n = 1 << 22, chunk = 1 << 16;
+	vector<double> telemetry(n), telemetry_out(n);
+	vector<uint16_t> samples(n), samples_out(n);
+	for (size_t i = 0; i < n; ++i) {
+		uint32_t noise = uint32_t(i) * 2654435761u;
+		telemetry[i] = round((20.0 + 5.0*sin(double(i)*1e-4) + 1e-3*double(noise % 100)) * 1000.0) / 1000.0;
+		samples[i] = uint16_t((2048 + 1500 * sin(double(i)*1e-3) + double(noise % 64)));
+	}
+	H5TL::File f("bench_lossy.h5", H5TL::File::TRUNCATE);
+	vector<pair<string, H5TL::DProps>> telemetry_props;
+	telemetry_props.emplace_back("deflate1", H5TL::DProps().chunked({ chunk }).deflate(1));
+	telemetry_props.emplace_back("deflate6", H5TL::DProps().chunked({ chunk }).deflate(6));
+	telemetry_props.emplace_back("shuffle_deflate1", H5TL::DProps().chunked({ chunk }).shuffle().deflate(1));
+	telemetry_props.emplace_back("scale_offset3", H5TL::DProps().chunked({ chunk }).scale_offset(H5Z_SO_FLOAT_DSCALE, 3));
+	telemetry_props.emplace_back("scale_offset3_deflate1", H5TL::DProps().chunked({ chunk }).scale_offset(H5Z_SO_FLOAT_DSCALE, 3).deflate(1));
+	for (auto &p : telemetry_props)
+		bench_filter(f, "lossy_" + p.first + "_double", p.second, H5TL::DType::DOUBLE, telemetry.data(), telemetry_out.data(), H5TL::DType::DOUBLE, n);
+	H5TL::DType twelve_bit(H5TL::DType::UINT16);
+	twelve_bit.precision(12);
+	bench_filter(f, "lossy_deflate1_uint16", H5TL::DProps().chunked({ chunk }).deflate(1), H5TL::DType::UINT16, samples.data(), samples_out.data(), H5TL::DType::UINT16, n);
+	bench_filter(f, "lossy_shuffle_deflate1_uint16", H5TL::DProps().chunked({ chunk }).shuffle().deflate(1), H5TL::DType::UINT16, samples.data(), samples_out.data(), H5TL::DType::UINT16, n);
+	bench_filter(f, "lossy_nbit12_uint16", H5TL::DProps().chunked({ chunk }).nbit(), twelve_bit, samples.data(), samples_out.data(), H5TL::DType::UINT16, n);
+	bench_filter(f, "lossy_scale_offset_uint16", H5TL::DProps().chunked({ chunk }).scale_offset(), H5TL::DType::UINT16, samples.data(), samples_out.data(), H5TL::DType::UINT16, n);
+}
+
+//scattered 16x16 tile writes into a compressed dataset, directly and through a WriteCombiner
+void bench_write_combiner() {
+	const hsize_t side = 1024, tile = 16, ntiles = (side / tile)*(side / tile);
+	vector<float> buffer(tile*tile, 1.0f);
+	//visit every tile once, in a scattered order
+	vector<hsize_t> order(ntiles);
+	for (hsize_t t = 0; t < ntiles; ++t)
+		order[t] = (t * 2654435761u) % ntiles;
+	H5TL::File f("bench_combiner.h5", H5TL::File::TRUNCATE);
+	H5TL::DProps props = H5TL::DProps().chunked({ 64, 64 }).deflate(1);
+	{
+		H5TL::Dataset ds = f.createDataset("direct", H5TL::DType::FLOAT, H5TL::DSpace({ side, side }), props);
+		bench("tile_write_direct", ntiles, [&](size_t i) {
+			hsize_t t = order[i];
+			ds.write(buffer, H5TL::DSpace({ tile, tile }), { t / (side / tile) * tile, t % (side / tile) * tile });
+		});
+	}
+	{
+		H5TL::Dataset ds = f.createDataset("combined", H5TL::DType::FLOAT, H5TL::DSpace({ side, side }), props);
+		auto t0 = chrono::steady_clock::now();
+		{
+			H5TL::WriteCombiner combiner(ds, H5TL::DType::FLOAT);
+			for (size_t i = 0; i < ntiles; ++i) {
+				hsize_t t = order[i];
+				combiner.write(buffer.data(), { tile, tile }, { t / (side / tile) * tile, t % (side / tile) * tile });
+			}
+		}
+		report("tile_write_combined", ntiles, chrono::duration<double>(chrono::steady_clock::now() - t0).count());
+	}
+}
+
+//stitching shard files together: copying them into one dataset, or mapping them into a virtual dataset, and reading each
+void bench_virtual() {
+	const hsize_t nshards = 8, rows = 512, cols = 1024;
+	const size_t nbytes = size_t(nshards * rows * cols * 4);
+	vector<float> shard(rows*cols, 1.0f), all(nshards*rows*cols);
+	for (hsize_t k = 0; k < nshards; ++k) {
+		H5TL::File s("bench_shard_" + to_string(k) + ".h5", H5TL::File::TRUNCATE);
+		s.write("data", shard, H5TL::DSpace({ rows, cols }));
+	}
+	H5TL::File f("bench_virtual.h5", H5TL::File::TRUNCATE);
+	bench_bytes("stitch_copy", 4, nbytes, [&](size_t i) {
+		H5TL::Dataset copy = f.createDataset("copy" + to_string(i), H5TL::DType::FLOAT, H5TL::DSpace({ nshards*rows, cols }));
+		for (hsize_t k = 0; k < nshards; ++k) {
+			H5TL::File s("bench_shard_" + to_string(k) + ".h5", H5TL::File::READ);
+			s.dataset("data").read(shard);
+			copy.write(shard, H5TL::DSpace({ rows, cols }), { k*rows, 0 });
+		}
+	});
+	bench("stitch_virtual", 4, [&](size_t i) {
+		hsize_t dims[] = { 0, cols }, maxdims[] = { H5TL::DSpace::UNL, cols };
+		H5TL::VirtualDatasetBuilder vds(H5TL::DType::FLOAT, H5TL::DSpace(dims, maxdims));
+		vds.map_series("bench_shard_%b.h5", "data", { rows, cols });
+		f.createDataset("virtual" + to_string(i), vds);
+	});
+	H5TL::Dataset copy = f.dataset("copy0"), virt = f.dataset("virtual0");
+	bench_bytes("read_copy", 10, nbytes, [&](size_t) {
+		copy.read(all.data(), H5TL::DType::FLOAT, H5TL::DSpace({ nshards*rows, cols }));
+	});
+	bench_bytes("read_virtual", 10, nbytes, [&](size_t) {
+		virt.read(all.data(), H5TL::DType::FLOAT, H5TL::DSpace({ nshards*rows, cols }));
+	});
+}
+
+//reads that allocate their buffer: plain, aligned and huge page vectors, and the conversion buffer size
+void bench_allocation() {
+	const hsize_t n = hsize_t(1) << 24;
+	const size_t nbytes = size_t(n) * 4;
+	H5TL::File f("bench_allocation.h5", H5TL::File::TRUNCATE);
+	{
+		vector<int> data(n);
+		iota(data.begin(), data.end(), 0);
+		f.write("data", data);
+	}
+	H5TL::Dataset ds = f.dataset("data");
+	bench_bytes("read_allocate_vector", 10, nbytes, [&](size_t) {
+		ds.read<vector<int>>();
+	});
+	bench_bytes("read_allocate_aligned_vector", 10, nbytes, [&](size_t) {
+		ds.read<H5TL::aligned_vector<int>>();
+	});
+	bench_bytes("read_allocate_huge_page_vector", 10, nbytes, [&](size_t) {
+		ds.read<H5TL::huge_page_vector<int>>();
+	});
+	//int to double, converted 1 MB at a time by default
+	H5TL::aligned_vector<double> converted(n);
+	bench_bytes("read_convert_default_buffer", 10, nbytes, [&](size_t) {
+		ds.read(converted);
+	});
+	//a page-aligned buffer of each size; converting in cache-sized pieces beats converting everything at once
+	for (size_t buffer_nbytes : { size_t(1) << 16, size_t(1) << 18, size_t(1) << 20, size_t(n) * 8 }) {
+		H5TL::aligned_vector<char, 4096> tconv(buffer_nbytes);
+		ds.transfer(H5TL::XProps().buffer(buffer_nbytes, tconv.data()));
+		bench_bytes("read_convert_aligned_buffer_" + to_string(buffer_nbytes >> 10) + "k", 10, nbytes, [&](size_t) {
+			ds.read(converted);
+		});
+	}
+	ds.transfer(H5TL::XProps::DEFAULT);
+}
+
+//flags stored a byte each, and packed 8 to a byte with BitMask; throughput is of unpacked flags
+void bench_bitmask() {
+	const size_t n = size_t(1) << 26;
+	H5TL::File f("bench_bitmask.h5", H5TL::File::TRUNCATE);
+	unique_ptr<bool[]> flags(new bool[n]);
+	for (size_t i = 0; i < n; ++i)
+		flags[i] = (i * 2654435761u) % 7 < 3;
+	bench_bytes("write_flags_bytes", 5, n, [&](size_t i) {
+		f.write("bytes_" + to_string(i), (const void*)flags.get(), H5TL::DType::INT8, H5TL::DSpace({ hsize_t(n) }));
+	});
+	bench_bytes("read_flags_bytes", 5, n, [&](size_t i) {
+		f.read("bytes_" + to_string(i), (void*)flags.get(), H5TL::DType::INT8, H5TL::DSpace({ hsize_t(n) }));
+	});
+	H5TL::BitMask mask;
+	bench_bytes("pack_bitmask", 5, n, [&](size_t) {
+		mask = H5TL::BitMask(flags.get(), n);
+	});
+	bench_bytes("unpack_bitmask", 5, n, [&](size_t) {
+		mask.unpack(flags.get());
+	});
+	bench_bytes("write_bitmask", 5, n, [&](size_t i) {
+		f.write("mask_" + to_string(i), H5TL::BitMask(flags.get(), n));
+	});
+	bench_bytes("read_bitmask", 5, n, [&](size_t i) {
+		f.dataset("mask_" + to_string(i)).read<H5TL::BitMask>().unpack(flags.get());
+	});
+	size_t set = 0;
+	bench_bytes("count_bitmask", 5, n, [&](size_t) {
+		set += mask.count();
+	});
+	vector<bool> v = mask.to_vector();
+	bench_bytes("write_vector_bool", 5, n, [&](size_t i) {
+		f.write("vector_" + to_string(i), v);
+	});
+	bench_bytes("read_vector_bool", 5, n, [&](size_t i) {
+		v = f.read<vector<bool>>("vector_" + to_string(i));
+	});
+	cerr << "flags set: " << set / 5 << " of " << n << endl;
+}
+
+//a strided view of a float buffer, like a region of an image or a column-major matrix
+struct View {
+	float* p;
+	vector<hsize_t> shape;
+	vector<hssize_t> strides;
+};
+namespace H5TL {
+	template<>
+	struct adapt<View> {
+		typedef const DType& dtype_return;
+		typedef float* data_return;
+		typedef const float* const_data_return;
+
+		static size_t rank(const View& v) { return v.shape.size(); }
+		static vector<hsize_t> shape(const View& v) { return v.shape; }
+		static dtype_return dtype(const View&) { return DType::FLOAT; }
+		static data_return data(View& v) { return v.p; }
+		static const_data_return data(const View& v) { return v.p; }
+		static vector<hssize_t> strides(const View& v) { return v.strides; }
+	};
+}
+
+//strided memory read and written in place, against copying it to or from a contiguous buffer
+void bench_strided() {
+	const hsize_t side = 4096, roi = 2048;
+	const size_t nbytes = size_t(roi * roi) * sizeof(float);
+	H5TL::File f("bench_strided.h5", H5TL::File::TRUNCATE);
+	vector<float> image(size_t(side * side)), copy(size_t(roi * roi));
+	iota(image.begin(), image.end(), 0.0f);
+	H5TL::Dataset ds = f.createDataset("roi", H5TL::DType::FLOAT, H5TL::DSpace({ roi, roi }));
+	//a region of the image: a hyperslab of it
+	View region = { &image[size_t(1000 * side + 1000)], { roi, roi }, { hssize_t(side), 1 } };
+	bench_bytes("write_roi_in_place", 10, nbytes, [&](size_t) {
+		ds.write(region);
+	});
+	bench_bytes("write_roi_copy", 10, nbytes, [&](size_t) {
+		for (size_t r = 0; r < roi; ++r)
+			std::copy_n(region.p + r * side, size_t(roi), copy.begin() + r * roi);
+		ds.write(copy);
+	});
+	bench_bytes("read_roi_in_place", 10, nbytes, [&](size_t) {
+		ds.read(region);
+	});
+	bench_bytes("read_roi_copy", 10, nbytes, [&](size_t) {
+		ds.read(copy);
+		for (size_t r = 0; r < roi; ++r)
+			std::copy_n(copy.begin() + r * roi, size_t(roi), region.p + r * side);
+	});
+	//a column-major matrix: gathered into a C-ordered copy, or scattered from one
+	View column_major = { image.data(), { roi, roi }, { 1, hssize_t(roi) } };
+	bench_bytes("write_column_major_in_place", 3, nbytes, [&](size_t) {
+		ds.write(column_major);
+	});
+	bench_bytes("read_column_major_in_place", 3, nbytes, [&](size_t) {
+		ds.read(column_major);
+	});
+	bench_bytes("write_column_major_transpose", 3, nbytes, [&](size_t) {
+		for (size_t r = 0; r < roi; ++r)
+			for (size_t c = 0; c < roi; ++c)
+				copy[r * roi + c] = image[c * roi + r];
+		ds.write(copy);
+	});
+}
+
+#ifdef H5TL_EIGEN_ADAPT
+//reads straight into Eigen matrices, against reading a vector and copying it in
+void bench_eigen() {
+	typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorXf;
+	const hsize_t n = 2048;
+	const size_t nbytes = size_t(n * n) * sizeof(float);
+	H5TL::File f("bench_eigen.h5", H5TL::File::TRUNCATE);
+	vector<float> copy(size_t(n * n));
+	iota(copy.begin(), copy.end(), 0.0f);
+	H5TL::Dataset ds = f.createDataset("m", H5TL::DType::FLOAT, H5TL::DSpace({ n, n }));
+	ds.write(copy);
+	RowMajorXf r(n, n);
+	Eigen::MatrixXf c(n, n);
+	bench_bytes("read_eigen_row_major", 10, nbytes, [&](size_t) {
+		ds.read(r);
+	});
+	bench_bytes("read_eigen_row_major_copy", 10, nbytes, [&](size_t) {
+		ds.read(copy);
+		for (Eigen::Index i = 0; i < r.rows(); ++i)
+			for (Eigen::Index j = 0; j < r.cols(); ++j)
+				r(i, j) = copy[size_t(i * n + j)];
+	});
+	bench_bytes("read_eigen_column_major", 10, nbytes, [&](size_t) {
+		ds.read(c);
+	});
+	bench_bytes("read_eigen_column_major_copy", 10, nbytes, [&](size_t) {
+		ds.read(copy);
+		for (Eigen::Index i = 0; i < c.rows(); ++i)
+			for (Eigen::Index j = 0; j < c.cols(); ++j)
+				c(i, j) = copy[size_t(i * n + j)];
+	});
+}
+#endif
+
+//building a pyramid on one thread and on all of them, and reading a zoomed out view from it against reading the full
+//resolution region and decimating it
+void bench_pyramid() {
+	const hsize_t side = 4096, view = 512;
+	const size_t nbytes = size_t(side * side) * sizeof(uint16_t);
+	H5TL::File f("bench_pyramid.h5", H5TL::File::TRUNCATE);
+	{
+		vector<uint16_t> image(size_t(side * side));
+		for (size_t i = 0; i < image.size(); ++i)
+			image[i] = uint16_t(i * 2654435761u >> 16);
+		f.write("image", image, H5TL::DSpace({ side, side }), H5TL::DProps().chunked({ 256, 256 }));
+	}
+	for (size_t nthreads : { size_t(1), size_t(0) }) {
+		string name = nthreads ? "build_pyramid_1_thread" : "build_pyramid_all_threads";
+		bench_bytes(name, 3, nbytes, [&](size_t i) {
+			f.createPyramid(name + to_string(i), "image", H5TL::Downsample::MEAN, 256, nthreads);
+		});
+	}
+	H5TL::Pyramid pyramid = f.pyramid("build_pyramid_1_thread0");
+	H5TL::Pyramid::Tile t = pyramid.tile({ 0, 0 }, { side, side }, { view, view });
+	vector<uint16_t> tile(size_t(view * view)), full(size_t(side * side));
+	bench("read_pyramid_view", 100, [&](size_t) {
+		pyramid.read(t, tile);
+	});
+	H5TL::Dataset image = f.dataset("image");
+	bench("read_full_and_decimate", 3, [&](size_t) {
+		image.read(full);
+		const hsize_t step = side / view;
+		for (size_t r = 0; r < view; ++r)
+			for (size_t c = 0; c < view; ++c)
+				tile[r * view + c] = full[size_t(r * step * side + c * step)];
+	});
+}
+
+//appending a sorted timestamp column with and without chunk stats, in large and small blocks, then finding a 1% range
+//of it with query() against reading the whole column and scanning it
+void bench_stats() {
+	const size_t n = size_t(1) << 22, block = size_t(1) << 16, nbytes = n * sizeof(double);
+	H5TL::File f("bench_stats.h5", H5TL::File::TRUNCATE);
+	vector<double> times(n);
+	for (size_t i = 0; i < times.size(); ++i)
+		times[i] = 1e-3 * double(i);
+	for (bool tracked : { false, true }) {
+		string name = tracked ? "append_tracked" : "append_untracked";
+		bench_bytes(name, 3, nbytes, [&](size_t i) {
+			H5TL::Dataset ds = f.createDataset(name + to_string(i), H5TL::DType::DOUBLE, H5TL::DSpace({ 0 }, { H5TL::DSpace::UNL }),
+				H5TL::DProps().chunked({ 16384 }));
+			if (tracked) ds.track_stats();
+			for (size_t r = 0; r < n; r += block)
+				ds.append(&times[r], H5TL::DType::DOUBLE, H5TL::DSpace({ hsize_t(block) }));
+		});
+	}
+	//appends much smaller than a chunk, which fold into the stats of the chunk they extend
+	const size_t small = size_t(1) << 16, row = 16;
+	for (bool tracked : { false, true }) {
+		string name = tracked ? "append_small_tracked" : "append_small_untracked";
+		bench_bytes(name, 3, small * sizeof(double), [&](size_t i) {
+			H5TL::Dataset ds = f.createDataset(name + to_string(i), H5TL::DType::DOUBLE, H5TL::DSpace({ 0 }, { H5TL::DSpace::UNL }),
+				H5TL::DProps().chunked({ 16384 }));
+			if (tracked) ds.track_stats();
+			for (size_t r = 0; r < small; r += row)
+				ds.append(&times[r], H5TL::DType::DOUBLE, H5TL::DSpace({ hsize_t(row) }));
+		});
+	}
+	const H5TL::Predicate range = H5TL::Predicate::between(1e-3 * double(n / 2), 1e-3 * double(n / 2 + n / 100));
+	size_t hits = 0;
+	for (bool tracked : { false, true }) {
+		H5TL::Dataset ds = f.dataset(tracked ? "append_tracked0" : "append_untracked0");
+		bench(tracked ? "query_range_tracked" : "query_range_untracked", 10, [&](size_t) {
+			hits += ds.query(range).size();
+		});
+	}
+	H5TL::Dataset ds = f.dataset("append_untracked0");
+	vector<double> all(n);
+	bench("full_read_and_scan", 10, [&](size_t) {
+		ds.read(all);
+		for (size_t i = 0; i < all.size(); ++i)
+			if (range(all[i])) ++hits;
+	});
+	if (hits == 0) cerr << "no hits" << endl;
+}
+
+//appending rows to a three-column table with append_rows against appending to each column's dataset, and reading
+//all the columns with read_rows against reading them one after another
+void bench_table() {
+	const size_t n = size_t(1) << 22, block = size_t(1) << 14;
+	const size_t nbytes = n * (sizeof(double) + sizeof(float) + sizeof(int32_t));
+	H5TL::File f("bench_table.h5", H5TL::File::TRUNCATE);
+	vector<double> t(n);
+	vector<float> v(n);
+	vector<int32_t> id(n);
+	for (size_t i = 0; i < n; ++i) {
+		t[i] = 1e-3 * double(i);
+		v[i] = float(i % 1000);
+		id[i] = int32_t(i);
+	}
+	H5TL::DProps props = H5TL::DProps().chunked({ 65536 });
+	const vector<pair<string, H5TL::DType>> columns = { { "t", H5TL::DType::DOUBLE }, { "v", H5TL::DType::FLOAT }, { "id", H5TL::DType::INT32 } };
+	bench_bytes("append_rows", 3, nbytes, [&](size_t i) {
+		H5TL::Table table = f.createTable("table" + to_string(i), columns, props);
+		for (size_t r = 0; r < n; r += block)
+			table.append_rows(block, { &t[r], &v[r], &id[r] });
+	});
+	bench_bytes("append_columns_separately", 3, nbytes, [&](size_t i) {
+		H5TL::Group g = f.createGroup("columns" + to_string(i));
+		H5TL::Dataset dt = g.createDataset("t", H5TL::DType::DOUBLE, H5TL::DSpace({ 0 }, { H5TL::DSpace::UNL }), props);
+		H5TL::Dataset dv = g.createDataset("v", H5TL::DType::FLOAT, H5TL::DSpace({ 0 }, { H5TL::DSpace::UNL }), props);
+		H5TL::Dataset di = g.createDataset("id", H5TL::DType::INT32, H5TL::DSpace({ 0 }, { H5TL::DSpace::UNL }), props);
+		for (size_t r = 0; r < n; r += block) {
+			H5TL::DSpace shape({ hsize_t(block) });
+			dt.append(&t[r], H5TL::DType::DOUBLE, shape);
+			dv.append(&v[r], H5TL::DType::FLOAT, shape);
+			di.append(&id[r], H5TL::DType::INT32, shape);
+		}
+	});
+	H5TL::Table table = f.table("table0");
+	bench_bytes("read_rows", 10, nbytes, [&](size_t) {
+		table.read_rows(0, n, {}, { t.data(), v.data(), id.data() });
+	});
+	bench_bytes("read_columns_one_by_one", 10, nbytes, [&](size_t) {
+		table.column("t").read(t);
+		table.column("v").read(v);
+		table.column("id").read(id);
+	});
+}
+
+//reading the rows in a time range of a time series through its index, against scanning its time column for them
+void bench_timeseries() {
+	const size_t n = size_t(1) << 22, block = size_t(1) << 14, window = 1000;
+	H5TL::File f("bench_timeseries.h5", H5TL::File::TRUNCATE);
+	vector<double> t(n);
+	vector<float> v(n);
+	for (size_t i = 0; i < n; ++i) {
+		t[i] = 1e-3 * double(i);
+		v[i] = float(i % 1000);
+	}
+	H5TL::DProps props = H5TL::DProps().chunked({ 65536 });
+	bench_bytes("append_timeseries", 3, n * (sizeof(double) + sizeof(float)), [&](size_t i) {
+		H5TL::TimeSeries<double> series = f.createTimeSeries<double>("series" + to_string(i), { { "v", H5TL::DType::FLOAT } }, props);
+		for (size_t r = 0; r < n; r += block)
+			series.append(block, &t[r], { &v[r] });
+	});
+	H5TL::TimeSeries<double> series = f.timeSeries<double>("series0");
+	vector<double> times;
+	vector<float> values;
+	size_t rows = 0;
+	bench("indexed_range_1k_rows", 1000, [&](size_t i) {
+		double t0 = 1e-3 * double(i * 2654435761u % (n - window));
+		rows += series.read_range(t0, t0 + 1e-3 * double(window), {}, times, values).second;
+	});
+	H5TL::Dataset time = series.table().column("time"), value = series.table().column("v");
+	vector<double> all(n);
+	bench("scanned_range_1k_rows", 10, [&](size_t i) {
+		double t0 = 1e-3 * double(i * 2654435761u % (n - window));
+		time.read(all);
+		hsize_t begin = hsize_t(lower_bound(all.begin(), all.end(), t0) - all.begin());
+		hsize_t end = hsize_t(lower_bound(all.begin(), all.end(), t0 + 1e-3 * double(window)) - all.begin());
+		values = value.read<vector<float>>({ end - begin }, { begin });
+		rows += values.size();
+	});
+	if (rows == 0) cerr << "no rows" << endl;
+}
+
+//reads that convert types, with HDF5's conversions and then with H5TL's registered in their place.
+//registering can't be undone, so this group runs last
+void bench_conversion() {
+	const hsize_t n = hsize_t(1) << 24;
+	H5TL::File f("bench_conversion.h5", H5TL::File::TRUNCATE);
+	{
+		vector<int32_t> i(n);
+		for (size_t k = 0; k < i.size(); ++k)
+			i[k] = int32_t(uint32_t(k) * 2654435761u);
+		f.write("int32", i);
+		H5TL::DType be(H5TL::DType::INT32);
+		be.order(H5T_ORDER_BE);
+		f.createDataset("int32_be", be, H5TL::DSpace({ n })).write(i);
+		f.write("uint16", vector<uint16_t>(i.begin(), i.end()));
+		f.write("double", vector<double>(i.begin(), i.end()));
+	}
+	H5TL::aligned_vector<int32_t> to_int32(n);
+	H5TL::aligned_vector<float> to_float(n);
+	H5TL::aligned_vector<double> to_double(n);
+	for (const char* suffix : { "", "_fast" }) {
+		if (*suffix) H5TL::convert::register_fast();
+		string s(suffix);
+		bench_bytes("read_int32_to_int32" + s, 10, size_t(n) * 4, [&](size_t) { f.dataset("int32").read(to_int32); });
+		bench_bytes("read_int32_to_float" + s, 10, size_t(n) * 4, [&](size_t) { f.dataset("int32").read(to_float); });
+		bench_bytes("read_int32_to_double" + s, 10, size_t(n) * 4, [&](size_t) { f.dataset("int32").read(to_double); });
+		bench_bytes("read_uint16_to_float" + s, 10, size_t(n) * 2, [&](size_t) { f.dataset("uint16").read(to_float); });
+		bench_bytes("read_double_to_float" + s, 10, size_t(n) * 8, [&](size_t) { f.dataset("double").read(to_float); });
+		bench_bytes("read_int32_be_to_int32" + s, 10, size_t(n) * 4, [&](size_t) { f.dataset("int32_be").read(to_int32); });
+	}
+}
+
+int main(int argc, char* argv[]) {
+	try {
+		H5TL::File f("bench.h5", H5TL::File::TRUNCATE);
+		vector<pair<string, function<void()>>> groups = {
+			{ "handles", [&] { bench_handles(f); } },
+			{ "adapters", [&] { bench_adapters(f); } },
+			{ "append", [&] { bench_append(f); } },
+			{ "hyperslab", [&] { bench_hyperslab(f); } },
+			{ "metadata", [&] { bench_metadata(f); } },
+			{ "reader_pool", bench_reader_pool },
+			{ "chunk_planner", bench_chunk_planner },
+			{ "compression", bench_compression },
+			{ "lossy", bench_lossy },
+			{ "write_combiner", bench_write_combiner },
+			{ "virtual", bench_virtual },
+			{ "allocation", bench_allocation },
+			{ "bitmask", bench_bitmask },
+			{ "strided", bench_strided },
+#ifdef H5TL_EIGEN_ADAPT
+			{ "eigen", bench_eigen },
+#endif
+			{ "pyramid", bench_pyramid },
+			{ "stats", bench_stats },
+			{ "table", bench_table },
+			{ "timeseries", bench_timeseries },
+			{ "conversion", bench_conversion },
+		};
+		vector<string> only(argv + 1, argv + argc);
+		unsigned major, minor, release;
+		H5get_libversion(&major, &minor, &release);
+		cerr << "HDF5 " << major << "." << minor << "." << release << endl;
+		cout << "benchmark,iterations,seconds,ns_per_op,value" << endl;
+		for (auto &g : groups) {
+			if (only.empty() || find(only.begin(), only.end(), g.first) != only.end())
+				g.second();
+		}
+		return 0;
+	} catch (H5TL::h5tl_error &e) {
+		cerr << e.what();
+		return 1;
+	}
+}
@@ -0,0 +1,70 @@
+/**********
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2014 Samuel Bear Powell
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+\**********/
+
+// H5TLParallelTest.cpp : Collective I/O from every rank of MPI_COMM_WORLD to one file.
+// Run with eg. mpirun -np 4 H5TLParallelTest; prints "parallel: passed" on rank 0 and returns 0 if every rank read back what was written.
+
+#define H5TL_PARALLEL
+#include "../H5TL/H5TL.hpp"
+#include <vector>
+#include <iostream>
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	MPI_Init(&argc, &argv);
+	int rank, nranks;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+	int failed = 0;
+	try {
+		H5TL::File f("parallel.h5", H5TL::File::TRUNCATE, H5TL::FAProps().mpio(MPI_COMM_WORLD));
+		//the ranks ask for different numbers of rows, and get the most any of them asked for
+		hsize_t dims[] = { hsize_t(rank), 4 }, maxdims[] = { H5TL::DSpace::UNL, 4 };
+		H5TL::Dataset ds = f.createDataset(MPI_COMM_WORLD, "rows", H5TL::DType::INT32, H5TL::DSpace(dims, maxdims), H5TL::DProps().chunked({ 16, 4 }));
+		hsize_t first = hsize_t(nranks - 1);
+		if (ds.space().extent()[0] != first)
+			failed = 1;
+		//rank r appends r rows of r, after those rows; rank 0 appends none
+		vector<int> rows(size_t(rank) * 4, rank);
+		ds.append(MPI_COMM_WORLD, rows.data(), H5TL::DType::INT32, H5TL::DSpace({ hsize_t(rank), 4 }));
+		//every rank reads the whole dataset, collectively
+		ds.transfer(H5TL::XProps().collective());
+		vector<int> all = ds.read<vector<int>>();
+		vector<int> expected(first * 4, 0);
+		for (int r = 1; r < nranks; ++r)
+			expected.insert(expected.end(), size_t(r) * 4, r);
+		if (all != expected)
+			failed = 1;
+	} catch (H5TL::h5tl_error &e) {
+		cerr << "rank " << rank << ": " << e.what();
+		failed = 1;
+	} catch (std::runtime_error &e) {
+		cerr << "rank " << rank << ": " << e.what() << endl;
+		failed = 1;
+	}
+	MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+	if (rank == 0)
+		cout << "parallel: " << (failed ? "failed" : "passed") << " on " << nranks << " ranks" << endl;
+	MPI_Finalize();
+	return failed;
+}
@@ -31,6 +31,7 @@
 #include <iostream>
 #include <algorithm>
 #include <numeric>
+#include <cmath>
 using namespace std;
 
 //#include "blitz/Array.h"
@@ -60,6 +61,40 @@ ostream& operator<<(ostream& os, const vector<T>& vec) {
 	return os;
 }
 
+//a strided view of a float buffer, standing in for sliced, transposed or column-major arrays
+struct View {
+	float* p;
+	vector<hsize_t> shape;
+	vector<hssize_t> strides;
+};
+namespace H5TL {
+	template<>
+	struct adapt<View> {
+		typedef const DType& dtype_return;
+		typedef float* data_return;
+		typedef const float* const_data_return;
+
+		static size_t rank(const View& v) { return v.shape.size(); }
+		static vector<hsize_t> shape(const View& v) { return v.shape; }
+		static dtype_return dtype(const View&) { return DType::FLOAT; }
+		static data_return data(View& v) { return v.p; }
+		static const_data_return data(const View& v) { return v.p; }
+		static vector<hssize_t> strides(const View& v) { return v.strides; }
+	};
+}
+
+//the value checks print true or false, like the other results, and fail the test if false
+int failed_checks = 0;
+bool expect(bool ok) {
+	if (!ok) ++failed_checks;
+	return ok;
+}
+
+//takes any group by value, including a File
+bool has_note(H5TL::Group g) {
+	return g.exists("note");
+}
+
 int main(int argc, char* argv[]) {
 	try {
 		H5TL::File f("test.h5",H5TL::File::TRUNCATE);
@@ -85,8 +120,42 @@ int main(int argc, char* argv[]) {
 		c.resize(13);
 		cds.read(c);
 		cout << "c: " << c;
+
+		//copies of a Dataset share one HDF5 id, which stays open until the last copy closes
+		vector<H5TL::Dataset> handles(4, cds);
+		cds.close();
+		cout << "shared handles: " << handles[0].refcount() << endl;
+		handles[3].read(c);
+		cout << "c: " << c;
+		//a File copied into a Group shares the file's id, and closes it as a file
+		cout << boolalpha << "file as a group: " << expect(has_note(f)) << endl;
 		
-		//vector<bool> doesn't work because the standard is weird
+		//reads into buffers aligned for SIMD
+		H5TL::aligned_vector<float> aligned = f.read<H5TL::aligned_vector<float>>("data/a");
+		cout << boolalpha << "aligned to 64: " << expect(uintptr_t(aligned.data()) % 64 == 0) << endl;
+		cout << "aligned: " << vector<float>(aligned.begin(), aligned.end());
+		//pointers come from new[] unless an allocation is set, and then from it, to be freed with deallocate()
+		float* plain = f.read<float*>("data/a");
+		cout << "plain pointer: " << plain[9];
+		delete[] plain;
+		H5TL::set_allocation(H5TL::aligned_allocation<64>());
+		float* hooked = f.read<float*>("data/a");
+		cout << ", aligned pointer: " << expect(uintptr_t(hooked) % 64 == 0) << endl;
+		H5TL::deallocate(hooked);
+		H5TL::set_allocation(H5TL::allocation());
+
+		//big-endian data, and conversions done by H5TL's kernels instead of HDF5's
+		{
+			H5TL::DType be(H5TL::DType::INT32);
+			be.order(H5T_ORDER_BE);
+			f.createDataset("data/a_be", be, H5TL::DSpace({ 10 })).write(a);
+			vector<double> before = f.read<vector<double>>("data/a");
+			H5TL::convert::register_fast();
+			cout << "big-endian: " << f.read<vector<int>>("data/a_be");
+			cout << "fast conversion matches: " << expect(f.read<vector<double>>("data/a") == before && f.read<vector<float>>("data/a_be") == b) << endl;
+		}
+
+		//arrays of bool are stored a byte per flag
 		array<bool,10> d; 
 		for(size_t i = 0; i < d.size(); ++i)
 			d[i] = (i % 2 == 0);
@@ -94,9 +163,431 @@ int main(int argc, char* argv[]) {
 		f.write("d",d);
 		array<bool,10> e = f.read<array<bool,10>>("d");
 		cout << "e: " << e;
-		
+
+		//strided memory is written and read in place: a column-major matrix, and a region of a larger image
+		{
+			float column_major[] = { 1, 4, 2, 5, 3, 6 };
+			View cm = { column_major, { 2, 3 }, { 1, 2 } };
+			f.write("strided/column_major", cm);
+			cout << "column-major: " << f.read<vector<float>>("strided/column_major");
+			vector<float> image(20);
+			iota(image.begin(), image.end(), 0.0f);
+			View roi = { &image[6], { 2, 3 }, { 5, 1 } };
+			f.write("strided/roi", roi);
+			cout << "roi: " << f.read<vector<float>>("strided/roi");
+			f.read("strided/column_major", roi);
+			cout << "image: " << image;
+			f.dataset("strided/roi").read(cm);
+			cout << "column-major from roi: " << vector<float>(begin(column_major), end(column_major));
+		}
+
+		//writes through a selection change only the selected items
+		{
+			H5TL::Dataset selected = f.createDataset("data/selected", H5TL::DType::INT32, H5TL::DSpace({ 10 }));
+			selected.write(vector<int>(10, 0));
+			const hsize_t start[] = { 2 }, count[] = { 3 }, start2[] = { 7 }, count2[] = { 2 };
+			selected.write(vector<int>{ 7, 8, 9 }, H5TL::Hyperslab(start, count));
+			selected.write(vector<int>{ 4, 5 }, H5TL::DSpace({ 2 }), H5TL::Hyperslab(start2, count2));
+			vector<int> all = selected.read<vector<int>>();
+			cout << "selected: " << all;
+			expect(all == vector<int>{ 0, 0, 7, 8, 9, 0, 0, 4, 5, 0 });
+		}
+
+#ifdef H5TL_EIGEN_ADAPT
+		//Eigen matrices of either storage order, and blocks of them, are stored like a copy in C order
+		{
+			Eigen::MatrixXf m(3, 4);
+			vector<float> copy;
+			for (int i = 0; i < 3; ++i) {
+				for (int j = 0; j < 4; ++j) {
+					m(i, j) = float(10 * i + j);
+					copy.push_back(m(i, j));
+				}
+			}
+			f.write("eigen/m", m);
+			cout << "eigen matches copy: " << expect(f.read<vector<float>>("eigen/m") == copy) << endl;
+			typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorXf;
+			RowMajorXf r = f.read<RowMajorXf>("eigen/m");
+			Eigen::MatrixXf c = f.read<Eigen::MatrixXf>("eigen/m");
+			cout << "eigen read: " << expect(r == m) << ", " << expect(c == m) << endl;
+			Eigen::MatrixXf z = Eigen::MatrixXf::Zero(5, 6);
+			auto block = z.block(1, 2, 3, 4);
+			f.read("eigen/m", block);
+			cout << "eigen block: " << expect(z.block(1, 2, 3, 4) == m) << ", outside: " << expect(z.sum() == m.sum()) << endl;
+			f.write("eigen/v", Eigen::Vector3d(1, 2, 3));
+			cout << "eigen vector: " << f.read<vector<double>>("eigen/v");
+		}
+#endif
+
+#ifdef __cpp_lib_mdspan
+		//std::mdspan, in either layout
+		{
+			float left[] = { 1, 4, 2, 5, 3, 6 };
+			std::mdspan<float, std::dextents<size_t, 2>, std::layout_left> ml(left, 2, 3);
+			f.write("mdspan/left", ml);
+			cout << "mdspan left: " << f.read<vector<float>>("mdspan/left");
+			float right[6] = {};
+			std::mdspan<float, std::dextents<size_t, 2>> mr(right, 2, 3);
+			f.read("mdspan/left", mr);
+			cout << "mdspan right: " << vector<float>(begin(right), end(right));
+		}
+#endif
+
+		//vector<bool> and BitMask are stored packed, 8 flags to a byte
+		{
+			vector<bool> flags(21);
+			for (size_t i = 0; i < flags.size(); ++i)
+				flags[i] = (i % 3 == 0);
+			f.write("flags", flags);
+			H5TL::Dataset fds = f.dataset("flags");
+			cout << "packed bytes: " << fds.space().count() << endl;
+			vector<bool> flags_read = f.read<vector<bool>>("flags");
+			cout << "flags: " << flags_read;
+			H5TL::BitMask mask = fds.read<H5TL::BitMask>();
+			cout << "mask matches: " << expect(mask == H5TL::BitMask(flags)) << ", set: " << mask.count() << endl;
+			cout << "flags 5 to 15: " << fds.read<vector<bool>>({ 10 }, { 5 });
+		}
+
+		//nested std::arrays take their shape from their type, and go out as one buffer
+		{
+			vector<array<float, 3>> points(4);
+			for (size_t i = 0; i < points.size(); ++i)
+				points[i] = { { float(i), float(10 * i), float(100 * i) } };
+			f.write("nested/points", points);
+			cout << "points shape: " << f.dataset("nested/points").space().extent();
+			auto points_read = f.read<vector<array<float, 3>>>("nested/points");
+			cout << "points match: " << expect(points_read == points) << endl;
+			auto middle = f.dataset("nested/points").read<vector<array<float, 3>>>({ 2, 3 }, { 1, 0 });
+			cout << "middle points: " << middle.size() << ", " << middle[1][2] << endl;
+			//a {3, 2} dataset doesn't end in the shape of array<float, 3>, so it isn't regrouped into 2 of them
+			f.write("nested/transposed", vector<float>(6), H5TL::DSpace({ 3, 2 }));
+			bool refused = false;
+			try {
+				f.read<vector<array<float, 3>>>("nested/transposed");
+			}
+			catch (std::runtime_error&) {
+				refused = true;
+			}
+			cout << "transposed refused: " << expect(refused) << endl;
+			array<array<double, 4>, 4> identity = {};
+			for (size_t i = 0; i < 4; ++i)
+				identity[i][i] = 1;
+			f.write("nested/identity", identity);
+			cout << "identity shape: " << f.dataset("nested/identity").space().extent();
+			cout << "identity matches: " << expect(f.read<array<array<double, 4>, 4>>("nested/identity") == identity) << endl;
+		}
+
+		//probing for a missing dataset reports the failure instead of throwing it
+		auto missing = f.try_dataset("data/missing");
+		cout << "data/missing: " << (missing ? "found" : "not found") << endl;
+		cout << "data/a exists: " << expect(f.try_exists("data/a").value()) << endl;
+		cout << "empty stack: " << H5TL::h5tl_error(H5Ecreate_stack()).what() << endl;
+
+		//concurrent reads through a pool; the two halves are adjacent, so they may be merged into one read
+		{
+			H5TL::ReaderPool pool("test.h5", 2);
+			vector<int> g(10);
+			auto g0 = pool.read("data/a", g.data(), { 5 }, { 0 });
+			auto g1 = pool.read("data/a", g.data() + 5, { 5 }, { 5 });
+			g0.get();
+			g1.get();
+			cout << "g: " << g;
+			//strided memory is scattered from a C-ordered copy once the read is done
+			float column_major[6] = {};
+			View cm = { column_major, { 2, 3 }, { 1, 2 } };
+			pool.read("strided/column_major", cm, { 2, 3 }, { 0, 0 }).get();
+			cout << "pooled column-major: " << expect(vector<float>(begin(column_major), end(column_major)) == vector<float>{ 1, 4, 2, 5, 3, 6 }) << endl;
+		}
+
+		//a pyramid of downsampled copies of an image, and views of it read from the coarsest level that will do
+		{
+			const hsize_t rows = 100, cols = 70;
+			vector<uint16_t> image(size_t(rows * cols));
+			iota(image.begin(), image.end(), uint16_t(0));
+			f.write("image", image, H5TL::DSpace({ rows, cols }));
+			H5TL::Pyramid pyramid = f.createPyramid("image_pyramid", "image", H5TL::Downsample::MEAN, 16, 2);
+			cout << "pyramid levels: " << pyramid.size() << ", top: " << pyramid.extent(pyramid.size() - 1);
+			vector<uint16_t> level1 = pyramid.level(1).read<vector<uint16_t>>(), means;
+			for (size_t r = 0; r < rows; r += 2) {
+				for (size_t c = 0; c < cols; c += 2) {
+					size_t i = r * cols + c;
+					means.push_back(uint16_t(floor((image[i] + image[i + 1] + image[i + cols] + image[i + cols + 1]) / 4.0 + 0.5)));
+				}
+			}
+			cout << "level 1 means match: " << expect(level1 == means) << endl;
+			H5TL::Pyramid::Tile t = pyramid.tile({ 0, 0 }, { rows, cols }, { 20, 15 });
+			cout << "view level: " << t.level << ", shape: " << t.shape;
+			cout << "view items: " << pyramid.read<vector<uint16_t>>(t).size() << endl;
+			H5TL::Pyramid maxima = f.createPyramid("image_maxima", "image", H5TL::Downsample::MAX, 16);
+			vector<uint16_t> top = maxima.level(maxima.size() - 1).read<vector<uint16_t>>();
+			cout << "top maximum: " << *max_element(top.begin(), top.end()) << endl;
+			cout << "reopened levels: " << f.pyramid("image_pyramid").size() << endl;
+		}
+
+		//chunk stats kept through writes and appends, so a range query reads only the chunks that can match
+		{
+			vector<double> times(1000);
+			for (size_t i = 0; i < times.size(); ++i)
+				times[i] = 0.5 * double(i);
+			H5TL::Dataset tds = f.createDataset("stats/times", H5TL::DType::DOUBLE, H5TL::DSpace({ 0 }, { H5TL::DSpace::UNL }), H5TL::DProps().chunked({ 100 }));
+			tds.track_stats();
+			tds.append(times);
+			times.resize(1500);
+			for (size_t i = 1000; i < times.size(); ++i)
+				times[i] = 0.5 * double(i);
+			times[1234] = NAN;
+			tds.append(vector<double>(times.begin() + 1000, times.end()));
+			vector<H5TL::ChunkStats> cs = f.dataset("stats/times").chunk_stats();
+			cout << "stats chunks: " << cs.size() << ", chunk 12: " << cs[12].min << " " << cs[12].max << " " << cs[12].sum << " " << cs[12].count << " " << cs[12].nan_count << endl;
+			H5TL::Predicate p = H5TL::Predicate::between(100, 150);
+			size_t skipped = 0;
+			for (const H5TL::ChunkStats& s : cs)
+				skipped += s.known && !p.may_match(s);
+			vector<hsize_t> found = tds.query(p), expected;
+			for (size_t i = 0; i < times.size(); ++i)
+				if (p(times[i])) expected.push_back(i);
+			cout << "query matches: " << expect(found == expected) << ", items: " << found.size() << ", chunks skipped: " << skipped << endl;
+			//overwriting a chunk updates its stats, through another handle opened later
+			H5TL::Dataset again = f.dataset("stats/times");
+			again.write(vector<double>(10, -1.0), vector<hsize_t>{ 505 });
+			cout << "rewritten chunk 5 min: " << again.chunk_stats()[5].min << ", below 0: " << again.query(H5TL::Predicate::below(0)).size() << endl;
+			//without stats every chunk is read; indices count through the flattened dataset
+			vector<int> grid(60);
+			iota(grid.begin(), grid.end(), 0);
+			H5TL::Dataset gds = f.write("stats/grid", grid, H5TL::DSpace({ 6, 10 }), H5TL::DProps().chunked({ 4, 4 }));
+			cout << "grid chunks known: " << gds.chunk_stats()[0].known << ", 2D query: " << gds.query(H5TL::Predicate::between(27, 33));
+			gds.track_stats();
+			cout << "grid tracked, chunk 0 max: " << gds.chunk_stats()[0].max << ", above 58: " << gds.query(H5TL::Predicate::above(58));
+			//appends fold into the stats of the chunks they extend, as a recompute would find them
+			H5TL::Dataset rds = f.createDataset("stats/rows", H5TL::DType::FLOAT, H5TL::DSpace({ 0, 3 }, { H5TL::DSpace::UNL, 3 }), H5TL::DProps().chunked({ 4, 3 }));
+			rds.track_stats();
+			for (int r = 0; r < 10; ++r)
+				rds.append(vector<int>{ r + 1, -r - 1, r == 6 ? 100 : 2 * r + 1 });
+			vector<H5TL::ChunkStats> folded = rds.chunk_stats();
+			rds.track_stats();
+			vector<H5TL::ChunkStats> recomputed = rds.chunk_stats();
+			bool same = folded.size() == recomputed.size();
+			for (size_t c = 0; same && c < folded.size(); ++c)
+				same = folded[c].min == recomputed[c].min && folded[c].max == recomputed[c].max && folded[c].sum == recomputed[c].sum && folded[c].count == recomputed[c].count;
+			cout << "appended chunk 1: " << folded[1].min << " " << folded[1].max << " " << folded[1].count << ", as recomputed: " << expect(same);
+			//rows added by a resize hold fill values until written, which the stats don't count
+			rds.resize({ 12, 3 });
+			cout << ", chunk 2 count: " << rds.chunk_stats()[2].count << ", fill items: " << rds.query(H5TL::Predicate::equal(0)).size();
+			cout << ", root tagged: " << expect(f.hasAttribute("/", "H5TL_stats")) << endl;
+		}
+
+		//a table's columns are appended to together, and read together
+		{
+			H5TL::Table table = f.createTable("table", { { "id", H5TL::DType::INT32 }, { "x", H5TL::DType::DOUBLE }, { "flag", H5TL::DType::UINT8 } });
+			table.append_rows(vector<int>{ 1, 2, 3 }, vector<double>{ 0.5, 1.5, 2.5 }, vector<uint8_t>{ 1, 0, 1 });
+			//a column left longer by an interrupted append is cut back by the next one
+			table.column("x").resize({ 7 });
+			int ids[] = { 4, 5 };
+			double xs[] = { 3.5, 4.5 };
+			uint8_t flags[] = { 0, 0 };
+			table.append_rows(2, { ids, xs, flags });
+			cout << "table rows: " << table.rows() << ", x extent: " << table.column("x").space().extent();
+			vector<float> x(3);
+			vector<int64_t> id(3);
+			table.read_rows(1, 4, { "x", "id" }, x, id);
+			cout << "rows 1 to 4: " << x << "ids: " << id;
+			H5TL::Table reopened = f.table("table");
+			cout << "reopened columns: " << reopened.columns().size() << ", rows: " << reopened.rows() << ", flags: " << reopened.read<vector<int>>("flag", 0, 5);
+			try {
+				reopened.read_rows(3, 6, {}, x, id, x);
+			}
+			catch (std::runtime_error &err) {
+				cout << "past the end: " << err.what() << endl;
+			}
+			//strided buffers are appended and read in their own layout: a column of a row-major matrix, and column-major
+			H5TL::Table strided = f.createTable("table_strided", { { "v", H5TL::DType::FLOAT } });
+			float matrix[] = { 0, 10, 1, 11, 2, 12, 3, 13 }, every_other[8] = {}, column_major[4] = {};
+			strided.append_rows(View{ matrix, { 4 }, { 2 } });
+			View column = { every_other, { 4 }, { 2 } }, square = { column_major, { 2, 2 }, { 1, 2 } };
+			strided.read_rows(0, 4, {}, column);
+			strided.read_rows(0, 4, { "v" }, square);
+			cout << "strided column: " << expect(strided.read<vector<float>>("v", 0, 4) == vector<float>{ 0, 1, 2, 3 });
+			cout << ", read: " << expect(vector<float>(begin(every_other), end(every_other)) == vector<float>{ 0, 0, 1, 0, 2, 0, 3, 0 });
+			cout << ", column-major: " << expect(vector<float>(begin(column_major), end(column_major)) == vector<float>{ 0, 2, 1, 3 }) << endl;
+		}
+
+		//a time series finds the rows in a time range from a sparse index of its timestamps
+		{
+			H5TL::TimeSeries<int64_t> series = f.createTimeSeries<int64_t>("series", { { "value", H5TL::DType::FLOAT } }, H5TL::DProps::DEFAULT, 4);
+			series.append(vector<int64_t>{ 0, 10, 10, 20, 30, 40, 40 }, vector<float>{ 0, 1, 2, 3, 4, 5, 6 });
+			int64_t more_times[] = { 50, 60, 70, 70, 70 };
+			float more_values[] = { 7, 8, 9, 10, 11 };
+			series.append(5, more_times, { more_values });
+			vector<int64_t> t;
+			vector<float> v;
+			auto rows = series.read_range(10, 41, {}, t, v);
+			cout << "rows " << rows.first << " to " << rows.second << ", times: " << t << "values: " << v;
+			cout << "at or after 70: " << series.read_range<vector<float>>(70, 100, "value");
+			cout << "before 0: " << series.rows_between(-5, 0).second << ", after 70: " << series.locate(71) << endl;
+			try {
+				series.append(vector<int64_t>{ 65 }, vector<float>{ 0 });
+			}
+			catch (std::runtime_error &err) {
+				cout << "out of order: " << err.what() << endl;
+			}
+			//an index left short is completed from the time column
+			f.dataset("series/time_index").resize({ 1 });
+			H5TL::TimeSeries<int64_t> reopened = f.timeSeries<int64_t>("series");
+			cout << "reopened rows: " << reopened.rows() << ", between 45 and 70: " << reopened.read_range<vector<int64_t>>(45, 70, "time");
+			float matrix[] = { 12, 0, 13, 0 };
+			reopened.append(vector<int64_t>{ 80, 90 }, View{ matrix, { 2 }, { 2 } });
+			cout << "strided values: " << expect(reopened.read_range<vector<float>>(80, 100, "value") == vector<float>{ 12, 13 }) << endl;
+		}
+
+		//chunk shapes planned from how the data will be read
+		cout << "row chunks: " << H5TL::ChunkPlanner({ 100000, 512 }, 4).rows().plan();
+		cout << "column chunks: " << H5TL::ChunkPlanner({ 100000, 512 }, 4).columns().plan();
+		cout << "tile chunks: " << H5TL::ChunkPlanner({ 100000, 512 }, 4).tiles({ 64, 64 }).compressed().plan();
+
+		//filters set by id, and a clear error for one the library doesn't have
+		f.write("data/filtered", a, H5TL::DSpace({ 10 }), H5TL::DProps().chunked({ 5 }).filter(H5Z_FILTER_DEFLATE, H5Z_FLAG_MANDATORY, { 6 }));
+		cout << "filtered: " << f.read<vector<int>>("data/filtered");
+		f.createDataset("data/unreadable", H5TL::DType::INT32, H5TL::DSpace({ 10 }), H5TL::DProps().chunked({ 5 }).filter(305, H5Z_FLAG_OPTIONAL));
+		try {
+			f.dataset("data/unreadable").require_filters();
+		}
+		catch (H5TL::h5tl_error &err) {
+			cout << "unreadable: " << err.what() << endl;
+		}
+
+		//lossy scale-offset keeps 2 decimal digits, so values come back within 0.005; n-bit keeps 12 of 16 bits exactly
+		{
+			vector<double> h(1000);
+			for (size_t i = 0; i < h.size(); ++i)
+				h[i] = 20.0 + 5.0*sin(0.01*double(i));
+			f.write("data/scaled", h, H5TL::DSpace({ 1000 }), H5TL::DProps().scale_offset(H5Z_SO_FLOAT_DSCALE, 2));
+			vector<double> hr = f.read<vector<double>>("data/scaled");
+			double max_error = 0;
+			for (size_t i = 0; i < h.size(); ++i)
+				max_error = max(max_error, fabs(h[i] - hr[i]));
+			cout << "scale_offset error within 0.005: " << expect(max_error <= 0.005) << endl;
+			vector<uint16_t> k(1000);
+			for (size_t i = 0; i < k.size(); ++i)
+				k[i] = uint16_t(i * 37 % 4096);
+			H5TL::DType twelve_bit(H5TL::DType::UINT16);
+			twelve_bit.precision(12);
+			H5TL::Dataset kds = f.createDataset("data/nbit", twelve_bit, H5TL::DSpace({ 1000 }), H5TL::DProps().nbit());
+			kds.write(k);
+			cout << "nbit exact: " << expect(f.read<vector<uint16_t>>("data/nbit") == k) << endl;
+		}
+
+#if defined(H5TL_ZSTD) || defined(H5TL_LZ4)
+		//the built-in zstd and lz4 filters, on chunks that compress well and chunks that don't
+		{
+			vector<int32_t> m(4096);
+			for (size_t i = 0; i < m.size(); ++i)
+				m[i] = i < 2048 ? int32_t(i % 7) : int32_t(uint32_t(i) * 2654435761u);
+			vector<pair<string, H5TL::DProps>> builtin;
+#ifdef H5TL_ZSTD
+			builtin.emplace_back("zstd", H5TL::DProps().chunked({ 1024 }).zstd(3));
+#endif
+#ifdef H5TL_LZ4
+			builtin.emplace_back("lz4", H5TL::DProps().chunked({ 1024 }).lz4(1000));
+#endif
+			for (auto &p : builtin) {
+				H5TL::Dataset mds = f.write("data/" + p.first, m, H5TL::DSpace({ 4096 }), p.second);
+				cout << p.first << " exact: " << expect(f.read<vector<int32_t>>("data/" + p.first) == m)
+					<< ", compressed: " << expect(H5Dget_storage_size(mds) < m.size() * sizeof(int32_t)) << endl;
+			}
+		}
+#endif
+
+		//2x2 tiles combined into 4x4 chunks: three chunks are completed and written as they fill, the last waits for flush()
+		{
+			H5TL::Dataset tds = f.createDataset("data/tiles", H5TL::DType::INT32, H5TL::DSpace({ 8, 8 }), H5TL::DProps().chunked({ 4, 4 }).deflate(3).fill(-1));
+			H5TL::WriteCombiner combiner(tds, H5TL::DType::INT32);
+			for (hsize_t t = 0; t < 15; ++t) {
+				//visit the tiles out of order, leaving out the last one
+				hsize_t r = (t * 7 % 16) / 4 * 2, k = (t * 7 % 16) % 4 * 2;
+				array<int, 4> tile = {{ int(t), int(t), int(t), int(t) }};
+				combiner.write(tile.data(), { 2, 2 }, { r, k });
+			}
+			cout << "pending chunks: " << combiner.pending() << endl;
+			combiner.flush();
+			vector<int> tiles = f.read<vector<int>>("data/tiles");
+			cout << "tiles: " << tiles;
+			//strided memory is copied into C order as it is combined
+			H5TL::Dataset sds = f.createDataset("data/tiles_strided", H5TL::DType::FLOAT, H5TL::DSpace({ 2, 3 }), H5TL::DProps().chunked({ 2, 3 }));
+			H5TL::WriteCombiner strided(sds, H5TL::DType::FLOAT);
+			float column_major[] = { 1, 4, 2, 5, 3, 6 };
+			strided.write(View{ column_major, { 2, 3 }, { 1, 2 } }, { 0, 0 });
+			cout << "combined column-major: " << expect(f.read<vector<float>>("data/tiles_strided") == vector<float>{ 1, 2, 3, 4, 5, 6 }) << endl;
+		}
+
+		//a file built in memory, copied out as bytes, and opened again from them
+		{
+			vector<char> image;
+			{
+				H5TL::File m = H5TL::File::in_memory();
+				m.write("data/a", a);
+				m.writeAttribute("note", "in memory");
+				image = m.to_bytes();
+			}
+			H5TL::File copy = H5TL::File::from_bytes(image);
+			cout << "from bytes: " << copy.read<vector<int>>("data/a");
+			//files in memory open at the same time are kept apart
+			H5TL::File m1 = H5TL::File::in_memory(), m2 = H5TL::File::in_memory();
+			m1.write("x", 1);
+			m2.write("x", 2);
+			H5TL::File i1 = H5TL::File::from_bytes(m1.to_bytes()), i2 = H5TL::File::from_bytes(m2.to_bytes());
+			int x1 = i1.read<int>("x"), x2 = i2.read<int>("x");
+			cout << "two images: " << x1 << " " << x2 << endl;
+			expect(x1 == 1 && x2 == 2);
+		}
+
+		//two shard files stitched into one virtual dataset, and the same shards found by name as a growing series
+		{
+			for (int k = 0; k < 2; ++k) {
+				H5TL::File shard("shard_" + to_string(k) + ".h5", H5TL::File::TRUNCATE);
+				shard.write("data", vector<int>(6, k), H5TL::DSpace({ 2, 3 }));
+			}
+			H5TL::VirtualDatasetBuilder stitched(H5TL::DType::INT32, H5TL::DSpace({ 4, 3 }));
+			stitched.map({ 0, 0 }, "shard_0.h5", "data", { 2, 3 }).map({ 2, 0 }, "shard_1.h5", "data", { 2, 3 });
+			f.createDataset("virtual/stitched", stitched);
+			cout << "stitched: " << f.read<vector<int>>("virtual/stitched");
+			hsize_t dims[] = { 0, 3 }, maxdims[] = { H5TL::DSpace::UNL, 3 };
+			H5TL::VirtualDatasetBuilder series(H5TL::DType::INT32, H5TL::DSpace(dims, maxdims));
+			series.map_series("shard_%b.h5", "data", { 2, 3 });
+			f.createDataset("virtual/series", series);
+			cout << "series: " << f.dataset("virtual/series", H5TL::DAProps().chunk_cache(1 << 22)).read<vector<int>>();
+		}
+
+		//single writer, multiple readers: the reader follows rows as they are appended
+		{
+			H5TL::File w("swmr.h5", H5TL::File::TRUNCATE, H5TL::FAProps().libver_latest());
+			hsize_t dims[] = {0}, maxdims[] = {H5TL::DSpace::UNL};
+			H5TL::Dataset log = w.createDataset("log", H5TL::DType::INT32, H5TL::DSpace(dims, maxdims), H5TL::DProps().chunked({16}));
+			w.start_swmr_write();
+			H5TL::File r("swmr.h5", H5TL::File::SWMR_READ);
+			H5TL::Dataset follow = r.dataset("log");
+			hsize_t position = 0;
+			for (int k = 0; k < 3; ++k) {
+				array<int,3> rows = {{k, k, k}};
+				log.append(rows);
+				log.flush();
+				cout << "tail: " << follow.tail<vector<int>>(position);
+			}
+		}
+
+#ifdef H5TL_PROFILE
+		//counters for the HDF5 calls made on data/a above, summed over threads
+		for (auto &entry : H5TL::stats().totals())
+			if (entry.path == "/data/a")
+				cout << "profile /data/a " << entry.op << ": " << entry.calls << " calls, " << entry.bytes << " bytes" << endl;
+#endif
+
+		if (failed_checks > 0) {
+			cerr << failed_checks << " checks failed" << endl;
+			return 1;
+		}
 		return 0;
 	} catch(H5TL::h5tl_error &e) {
 		cerr << e.what();
+		return 1;
 	}
 }